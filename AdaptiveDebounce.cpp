@@ -0,0 +1,154 @@
+// AdaptiveDebounce.cpp
+#include "AdaptiveDebounce.h"
+#include <algorithm>
+
+namespace
+{
+  constexpr uint32_t kMinBounce = 8;  // bounce intervals needed to size the window
+  constexpr uint32_t kMinSignal = 32; // steps needed to cap it
+
+  // single writer: no read-modify-write needed
+  inline void bump(std::atomic<uint32_t> &c)
+  {
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // first bucket at which the cumulative count reaches q of n
+  int quantile(const uint32_t *h, int nb, uint64_t n, double q)
+  {
+    const double want = q * (double)n;
+    uint64_t acc = 0;
+    for (int b = 0; b < nb; ++b)
+    {
+      acc += h[b];
+      if ((double)acc >= want && acc > 0)
+        return b;
+    }
+    return nb - 1;
+  }
+}
+
+AdaptiveDebounce::AdaptiveDebounce(uint32_t window_ns, uint32_t update_edges)
+    : update_edges_(update_edges ? update_edges : 1), min_ns_(window_ns), max_ns_(window_ns),
+      window_ns_(window_ns)
+{
+}
+
+void AdaptiveDebounce::setRange(uint32_t min_ns, uint32_t max_ns)
+{
+  if (max_ns < min_ns)
+    max_ns = min_ns;
+  min_ns_.store(min_ns, std::memory_order_relaxed);
+  max_ns_.store(max_ns, std::memory_order_relaxed);
+  const uint32_t w = window_ns_.load(std::memory_order_relaxed);
+  window_ns_.store(std::min(std::max(w, min_ns), max_ns), std::memory_order_relaxed);
+}
+
+int AdaptiveDebounce::bucket(uint64_t ns)
+{
+  if (ns < 64)
+    return 0;
+  const int o = 63 - __builtin_clzll(ns);
+  const int b = 2 * (o - 6) + (int)((ns >> (o - 1)) & 1);
+  return std::min(b, kBuckets - 1);
+}
+
+uint64_t AdaptiveDebounce::bucketLow(int b)
+{
+  const int o = b / 2 + 6;
+  return (1ull << o) + (uint64_t)(b & 1) * (1ull << (o - 1));
+}
+
+bool AdaptiveDebounce::onEdge(int64_t t_ns, int64_t other_ns)
+{
+  const int64_t prev = last_ns_;
+  last_ns_ = t_ns;
+  edges_.fetch_add(1, std::memory_order_relaxed);
+  if (prev == 0 || t_ns <= prev)
+    return false;
+
+  const uint64_t dt = (uint64_t)(t_ns - prev);
+  bump(other_ns > prev ? signal_[bucket(dt)] : bounce_[bucket(dt)]);
+  if (++since_update_ >= update_edges_)
+  {
+    since_update_ = 0;
+    update_();
+  }
+
+  if (dt < window_ns_.load(std::memory_order_relaxed))
+  {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void AdaptiveDebounce::update_()
+{
+  const uint32_t lo = min_ns_.load(std::memory_order_relaxed);
+  const uint32_t hi = max_ns_.load(std::memory_order_relaxed);
+
+  uint32_t bh[kBuckets], sh[kBuckets];
+  for (int b = 0; b < kBuckets; ++b)
+  {
+    bh[b] = bounce_[b].load(std::memory_order_relaxed);
+    sh[b] = signal_[b].load(std::memory_order_relaxed);
+  }
+
+  // bounce: repeats on this line no longer than the widest allowed window;
+  // longer ones are direction changes, not something to filter
+  int nb = 0;
+  while (nb < kBuckets - 1 && bucketLow(nb + 1) <= hi)
+    ++nb;
+  uint64_t n_bounce = 0, n_signal = 0;
+  for (int b = 0; b < kBuckets; ++b)
+  {
+    if (b < nb)
+      n_bounce += bh[b];
+    n_signal += sh[b];
+  }
+
+  uint32_t bounce_ns = 0, signal_ns = 0;
+  if (n_bounce >= kMinBounce)
+    bounce_ns = (uint32_t)bucketLow(quantile(bh, nb, n_bounce, 0.99) + 1);
+  if (n_signal >= kMinSignal)
+    signal_ns = (uint32_t)std::min<uint64_t>(bucketLow(quantile(sh, kBuckets, n_signal, 0.01)), UINT32_MAX);
+
+  uint32_t w = std::max(bounce_ns, lo);
+  bool limited = false;
+  if (signal_ns && w > signal_ns / 2)
+  {
+    w = signal_ns / 2;
+    limited = bounce_ns > w;
+  }
+  w = std::min(std::max(w, lo), hi);
+
+  window_ns_.store(w, std::memory_order_relaxed);
+  bounce_p99_ns_.store(bounce_ns, std::memory_order_relaxed);
+  signal_p1_ns_.store(signal_ns, std::memory_order_relaxed);
+  limited_.store(limited, std::memory_order_relaxed);
+
+  // age: recent edges count twice as much as the previous period's
+  for (int b = 0; b < kBuckets; ++b)
+  {
+    bounce_[b].store(bh[b] / 2, std::memory_order_relaxed);
+    signal_[b].store(sh[b] / 2, std::memory_order_relaxed);
+  }
+}
+
+void AdaptiveDebounce::stats(Stats &out) const
+{
+  out.window_ns = window_ns_.load(std::memory_order_relaxed);
+  out.min_ns = min_ns_.load(std::memory_order_relaxed);
+  out.max_ns = max_ns_.load(std::memory_order_relaxed);
+  out.edges = edges_.load(std::memory_order_relaxed);
+  out.dropped = dropped_.load(std::memory_order_relaxed);
+  out.bounce_p99_ns = bounce_p99_ns_.load(std::memory_order_relaxed);
+  out.signal_p1_ns = signal_p1_ns_.load(std::memory_order_relaxed);
+  out.limited = limited_.load(std::memory_order_relaxed);
+  for (int b = 0; b < kBuckets; ++b)
+  {
+    out.bounce[b] = bounce_[b].load(std::memory_order_relaxed);
+    out.signal[b] = signal_[b].load(std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,71 @@
+// AdaptiveDebounce.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Debounce window of one encoder line, adapted online from the spacing of
+// its raw edges.
+//
+// Every raw edge lands in one of two log-spaced histograms of the interval
+// since the previous edge on the same line:
+//   - bounce: no edge on the other line in between. A clean quadrature
+//     signal always alternates lines, so these are bounce (or dithering
+//     around one edge);
+//   - signal: the other line moved in between, a real step.
+// Every 'update_edges' edges the window is set just above the bounce
+// population (its 99th percentile), but never above half the shortest
+// real spacing (1st percentile of signal), and kept within [min, max].
+// The histograms then decay by half, so they follow speed and cabling.
+//
+// onEdge() is called by the one decoding thread; the rest from any thread.
+class AdaptiveDebounce
+{
+public:
+  static constexpr int kBuckets = 48; // half octaves from 64 ns (~1 s in the last)
+
+  struct Stats
+  {
+    uint32_t window_ns;
+    uint32_t min_ns, max_ns;
+    uint64_t edges;         // raw edges seen
+    uint64_t dropped;       // of which inside the window
+    uint32_t bounce_p99_ns; // last estimate; 0: not enough bounce seen
+    uint32_t signal_p1_ns;  // last estimate; 0: not enough steps seen
+    bool limited;           // window held below the bounce by the signal
+    uint32_t bounce[kBuckets];
+    uint32_t signal[kBuckets];
+  };
+
+  explicit AdaptiveDebounce(uint32_t window_ns = 0, uint32_t update_edges = 256);
+
+  // adapt within [min_ns, max_ns]; min_ns == max_ns: fixed window (0: off)
+  void setRange(uint32_t min_ns, uint32_t max_ns);
+
+  // raw edge at t_ns (CLOCK_MONOTONIC); other_ns: last raw edge on the other
+  // line. true: inside the window of the previous edge, drop it
+  bool onEdge(int64_t t_ns, int64_t other_ns);
+  // last raw edge passed to onEdge (decoding thread only)
+  int64_t lastEdge() const { return last_ns_; }
+
+  uint32_t window_ns() const { return window_ns_.load(std::memory_order_relaxed); }
+  void stats(Stats &out) const;
+
+  static int bucket(uint64_t ns);
+  static uint64_t bucketLow(int b); // lower edge in ns
+
+private:
+  void update_();
+
+  const uint32_t update_edges_;
+  std::atomic<uint32_t> min_ns_, max_ns_;
+  std::atomic<uint32_t> window_ns_;
+  std::atomic<uint64_t> edges_{0}, dropped_{0};
+  std::atomic<uint32_t> bounce_p99_ns_{0}, signal_p1_ns_{0};
+  std::atomic<bool> limited_{false};
+  std::atomic<uint32_t> bounce_[kBuckets]{};
+  std::atomic<uint32_t> signal_[kBuckets]{};
+
+  // decoding thread only
+  int64_t last_ns_{0};
+  uint32_t since_update_{0};
+};
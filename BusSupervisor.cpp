@@ -0,0 +1,69 @@
+// BusSupervisor.cpp
+#include "BusSupervisor.h"
+#include <algorithm>
+
+BusSupervisor::BusSupervisor() : BusSupervisor(Params{}) {}
+
+BusSupervisor::BusSupervisor(const Params &p) : params_(p) {}
+
+BusSupervisor::~BusSupervisor() { stop(); }
+
+void BusSupervisor::attach(Motoron &m)
+{
+  boards_.push_back({&m, 0, 0});
+}
+
+void BusSupervisor::start()
+{
+  if (run_.exchange(true))
+    return;
+  th_ = std::thread(&BusSupervisor::loop_, this);
+}
+
+void BusSupervisor::stop()
+{
+  run_.store(false);
+  if (th_.joinable())
+    th_.join();
+}
+
+std::size_t BusSupervisor::service()
+{
+  const int64_t min_ns = std::chrono::nanoseconds(params_.min_backoff).count();
+  const int64_t max_ns = std::chrono::nanoseconds(params_.max_backoff).count();
+  std::size_t pending = 0;
+  for (Board &b : boards_)
+  {
+    if (b.m->health() != Motoron::Health::Recovering)
+    {
+      b.backoff_ns = 0;
+      continue;
+    }
+    const int64_t now = Motoron::nowNs();
+    if (now < b.next_ns)
+    {
+      ++pending;
+      continue;
+    }
+    if (b.m->recover())
+    {
+      b.backoff_ns = 0;
+      continue;
+    }
+    b.backoff_ns = b.backoff_ns ? std::min(2 * b.backoff_ns, max_ns) : min_ns;
+    b.next_ns = Motoron::nowNs() + b.backoff_ns;
+    ++pending;
+  }
+  return pending;
+}
+
+// Normal scheduling: recovery waits on the bus, it must not compete with
+// the RT threads for the CPU
+void BusSupervisor::loop_()
+{
+  while (run_.load())
+  {
+    service();
+    std::this_thread::sleep_for(params_.poll);
+  }
+}
@@ -0,0 +1,56 @@
+// BusSupervisor.h
+#pragma once
+#include "Motoron.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Brings Motoron boards back after bus faults or resets, off the control
+// thread.
+//
+// The control thread hands a board over by putting it in
+// Motoron::Health::Recovering (see Motoron::trySetSpeed); from then on only
+// this thread touches it, calling Motoron::recover() with exponential
+// backoff until the board answers again and is handed back.
+class BusSupervisor
+{
+public:
+  struct Params
+  {
+    std::chrono::milliseconds poll{5};           // how often to look for boards to recover
+    std::chrono::milliseconds min_backoff{10};   // after a failed recovery attempt
+    std::chrono::milliseconds max_backoff{1000};
+  };
+
+  BusSupervisor();
+  explicit BusSupervisor(const Params &p);
+  ~BusSupervisor();
+  BusSupervisor(const BusSupervisor &) = delete;
+  BusSupervisor &operator=(const BusSupervisor &) = delete;
+
+  // before start()
+  void attach(Motoron &m);
+  void start();
+  void stop();
+
+  // one pass over all boards (what the thread runs); returns how many are
+  // still recovering
+  std::size_t service();
+
+private:
+  struct Board
+  {
+    Motoron *m;
+    int64_t next_ns;
+    int64_t backoff_ns;
+  };
+
+  Params params_;
+  std::vector<Board> boards_;
+  std::atomic<bool> run_{false};
+  std::thread th_;
+  void loop_();
+};
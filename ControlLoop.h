@@ -0,0 +1,455 @@
+// ControlLoop.h
+#pragma once
+#include "util.h"
+#include "Overload.h"
+#include "TickProfiler.h"
+#include "LatencyTrace.h"
+#include "EncoderWake.h"
+#include "SeqLock.h"
+#include "SpectralMonitor.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <cerrno>
+#include <cmath>
+#include <time.h>
+
+// The 1 kHz control thread for a Robot<Config>: measured-dt PID updates,
+// overload rate stepping, per-phase profiling, edge-to-actuation latency
+// tracing and RT sentinels.
+//
+// Other threads exchange whole arrays with it: setReferences() hands over a
+// batch applied on one tick, state() returns the values of one tick.
+// Every tick's tracking error and command also go to samples(), a ring the
+// control thread only ever writes (see SpectralMonitor).
+//
+// Optional event-triggered mode (setEventMode): instead of ticking at the
+// fixed rate, the thread sleeps until an encoder has moved a threshold
+// number of counts (or the references changed, or a maximum interval
+// passed), then runs one tick with the measured dt. Ticks, and so bus
+// writes, stay at least one overload period apart.
+//
+// Optional idle-aware rate (setIdleMode): an axis whose reference is
+// unchanged, whose error is within tolerance and whose encoder count and
+// command have not moved for a settle time is idle. Idle axes get no bus
+// writes beyond what the Motoron command timeout needs; once every axis is
+// idle the thread sleeps, ticking at a low rate, and is back at full rate
+// on the first tick after an encoder count or a new reference.
+template <typename RobotT>
+class ControlLoop
+{
+public:
+  static constexpr std::size_t kAxes = RobotT::size();
+
+  struct State
+  {
+    int64_t t_ns{0}; // encoder snapshot time (CLOCK_MONOTONIC)
+    uint64_t tick{0};
+    std::array<double, kAxes> position{}; // revs
+    std::array<double, kAxes> reference{};
+    std::array<double, kAxes> command{}; // Motoron speed units
+  };
+
+  struct EventMode
+  {
+    int32_t threshold_counts{4};                    // per axis, since the last tick
+    std::chrono::microseconds max_interval{10000}; // tick at least this often (< Motoron command timeout)
+  };
+
+  // event-triggered mode wake-ups (cumulative)
+  struct EventStats
+  {
+    uint64_t edge_wakes{0};   // woken by encoder movement or wake()
+    uint64_t timeouts{0};     // max_interval passed
+    uint64_t immediate{0};    // moved again before the thread could sleep
+    uint64_t rate_limited{0}; // woken early, held to the period
+  };
+
+  struct IdleMode
+  {
+    double pos_tol_rev{0.0005};             // |reference - position| within this
+    std::chrono::milliseconds settle{200};  // quiet this long before an axis is idle
+    std::chrono::milliseconds period{20};   // tick period once every axis is idle
+    std::chrono::milliseconds refresh{500}; // rewrite each board this often (< Motoron command timeout)
+  };
+
+  // time per mode (cumulative)
+  struct IdleStats
+  {
+    uint64_t active_ns{0};                      // loop at the full (or event-triggered) rate
+    uint64_t idle_ns{0};                        // loop at the idle rate
+    std::array<uint64_t, kAxes> axis_idle_ns{}; // per axis: bus writes held
+    uint64_t entries{0};                        // whole loop went idle
+    uint64_t wakes{0};                          // idle sleeps cut short (encoder count, new reference)
+    uint64_t writes_held{0};                    // bus writes skipped on idle axes
+  };
+
+  using Sample = TrackingSample<kAxes>;
+  using SampleTap = TapRing<Sample, 4096>; // ~4 s at 1 kHz
+
+  explicit ControlLoop(RobotT &robot, int prio = 80)
+      : robot_(robot), prio_(prio)
+  {
+    robot_.setProfiler(&profiler_);
+    trace_writer_ = trace_.writer("control");
+  }
+  ~ControlLoop() { stop(); }
+  ControlLoop(const ControlLoop &) = delete;
+  ControlLoop &operator=(const ControlLoop &) = delete;
+
+  void start()
+  {
+    if (running_.exchange(true))
+      return;
+    th_ = std::thread(&ControlLoop::run_, this);
+  }
+  // joins the thread; outputs are coasted on the way out
+  void stop()
+  {
+    running_.store(false);
+    if (th_.joinable())
+      th_.join();
+    applyEnable_(); // a request the last tick did not see
+  }
+  bool running() const { return running_.load(); }
+
+  // before start(); the rest of the time the loop runs at the fixed rate
+  void setEventMode(const EventMode &m)
+  {
+    event_ = m;
+    event_on_ = true;
+    wake_ = &robot_.enableWake(m.threshold_counts);
+  }
+  bool eventMode() const { return event_on_; }
+  EventStats eventStats() const
+  {
+    EventStats s;
+    s.edge_wakes = ev_edge_.load(std::memory_order_relaxed);
+    s.timeouts = ev_timeout_.load(std::memory_order_relaxed);
+    s.immediate = ev_immediate_.load(std::memory_order_relaxed);
+    s.rate_limited = ev_held_.load(std::memory_order_relaxed);
+    return s;
+  }
+  // before start(); combines with event mode
+  void setIdleMode(const IdleMode &m)
+  {
+    idle_ = m;
+    idle_on_ = true;
+    if (!wake_)
+      wake_ = &robot_.enableWake(1);
+  }
+  bool idleMode() const { return idle_on_; }
+  IdleStats idleStats() const
+  {
+    IdleStats s;
+    s.active_ns = active_ns_.load(std::memory_order_relaxed);
+    s.idle_ns = idle_ns_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < kAxes; ++i)
+      s.axis_idle_ns[i] = axis_idle_ns_[i].load(std::memory_order_relaxed);
+    s.entries = idle_entries_.load(std::memory_order_relaxed);
+    s.wakes = idle_wakes_.load(std::memory_order_relaxed);
+    s.writes_held = robot_.heldWrites();
+    return s;
+  }
+
+  // event or idle mode: run a tick now (e.g. after Motor::setReference);
+  // no-op otherwise. The fence pairs with the re-check after arming, so a
+  // reference set just before the thread goes to sleep is not missed
+  void wake()
+  {
+    if (!wake_)
+      return;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake_->signal();
+  }
+
+  // enable / disable every axis: the control thread applies it at the
+  // start of its next tick, so no bus write comes from the caller. While
+  // stopped it is applied here (disable coasts). Not concurrent with
+  // start() / stop()
+  void requestEnable(bool en)
+  {
+    enable_req_.store(en ? 1 : 0);
+    if (running_.load())
+    {
+      wake();
+      return;
+    }
+    applyEnable_();
+    if (!en)
+      robot_.coastAll();
+  }
+
+  // whole batch lands on the same tick
+  void setReferences(const std::array<double, kAxes> &revs)
+  {
+    refs_.store(revs);
+    wake();
+  }
+  State state() const { return state_.load(); }
+  const SampleTap &samples() const { return tap_; }
+
+  ThreadMonitor &monitor() { return monitor_; }
+  OverloadManager &overload() { return overload_; }
+  TickProfiler &profiler() { return profiler_; }
+  LatencyTrace &trace() { return trace_; }
+
+private:
+  void run_()
+  {
+    try { set_realtime(prio_); } catch (...) {}
+    monitor_.tag_rt();
+    profiler_.attachPerf(); // counters follow this thread; silently off if perf is unavailable
+
+    timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    quiet_since_.fill((int64_t)t0.tv_sec * 1000000000ll + t0.tv_nsec); // settle from the start
+    int64_t last_poll_ns = 0;
+    State st;
+    bool tracing = false;
+    while (running_.load(std::memory_order_relaxed))
+    {
+      monitor_.begin_iter();
+      const auto period = overload_.period();
+
+      // Latency tracing and phase timing are non-critical: off while degraded
+      if (tracing == overload_.shedNonCritical())
+      {
+        tracing = !tracing;
+        robot_.setTracer(tracing ? trace_writer_ : nullptr);
+        robot_.setProfiler(tracing ? &profiler_ : nullptr);
+      }
+
+      // Integrate over the measured step; bound it so one long stall
+      // cannot dump a huge step into the integrator
+      auto meas = monitor_.last_dt();
+      if (meas.count() <= 0)
+        meas = period;
+      std::chrono::nanoseconds bound = 4 * period;
+      if (event_on_)
+        bound = std::max<std::chrono::nanoseconds>(bound, 2 * event_.max_interval);
+      if (idle_on_)
+      {
+        bound = std::max<std::chrono::nanoseconds>(bound, 2 * idle_.period);
+        account_(meas.count());
+      }
+      const double dt = std::min(std::chrono::duration<double>(meas).count(),
+                                 std::chrono::duration<double>(bound).count());
+
+      applyEnable_();
+
+      // New reference batch? (a torn read just waits for the next tick)
+      const uint32_t v = refs_.version();
+      std::array<double, kAxes> refs;
+      if (v != refs_seen_ && refs_.tryLoad(refs, 1))
+      {
+        refs_seen_ = v;
+        for (std::size_t i = 0; i < kAxes; ++i)
+          robot_.axis(i).setReference(refs[i]);
+      }
+
+      robot_.update(dt);
+
+      st.t_ns = robot_.lastSnapshot().t_ns;
+      ++st.tick;
+
+      // Driver status (reset detection) is the first thing shed when degraded
+      if (RobotT::kStatusPollNs > 0 && !overload_.shedNonCritical() &&
+          st.t_ns - last_poll_ns >= RobotT::kStatusPollNs)
+      {
+        robot_.pollDriverStatus();
+        last_poll_ns = st.t_ns;
+      }
+      for (std::size_t i = 0; i < kAxes; ++i)
+      {
+        st.position[i] = robot_.axis(i).position();
+        st.reference[i] = robot_.axis(i).reference();
+        st.command[i] = robot_.axis(i).command();
+      }
+      state_.store(st);
+      Sample smp;
+      // event mode or idle rate: not uniformly sampled
+      smp.period_ns = (event_on_ || loop_idle_) ? 0 : (uint32_t)period.count();
+      for (std::size_t i = 0; i < kAxes; ++i)
+      {
+        smp.err[i] = (float)(st.reference[i] - st.position[i]);
+        smp.cmd[i] = (float)st.command[i];
+      }
+      tap_.put(smp);
+      if (idle_on_)
+        detectIdle_(st);
+
+      if (!event_on_ && !loop_idle_)
+      {
+        const bool missed = monitor_.end_iter(period);
+        overload_.observe(missed, monitor_.last_busy());
+        continue;
+      }
+      const bool missed = monitor_.end_iter_nowait(period);
+      overload_.observe(missed, monitor_.last_busy());
+      if (loop_idle_)
+      {
+        if (waitForEvent_(st, period.count(), idle_.period) != Woken::Timeout)
+          idle_wakes_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      switch (waitForEvent_(st, period.count(), event_.max_interval))
+      {
+      case Woken::Immediate:
+        ev_immediate_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case Woken::Signal:
+        ev_edge_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case Woken::Timeout:
+        ev_timeout_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    robot_.setHeld(0, 0);
+    robot_.setTracer(nullptr);
+    robot_.coastAll();
+    monitor_.untag_rt();
+  }
+
+  void applyEnable_()
+  {
+    const int8_t en = enable_req_.exchange(-1);
+    if (en >= 0)
+      robot_.enable(en != 0);
+  }
+
+  enum class Woken : uint8_t
+  {
+    Immediate, // moved (or new references) before the thread could sleep
+    Signal,
+    Timeout
+  };
+
+  // Sleep until the encoders moved (or wake()) or 'timeout' after the
+  // tick's snapshot, but not before one period after it
+  Woken waitForEvent_(const State &st, int64_t period_ns, std::chrono::nanoseconds timeout)
+  {
+    const int64_t tick_ns = st.t_ns;
+    Woken why;
+    if (!robot_.armWake())
+      why = Woken::Immediate;
+    else if (referencesMoved_(st))
+    {
+      wake_->disarm();
+      why = Woken::Immediate;
+    }
+    else
+      why = wake_->waitUntil(tick_ns + timeout.count()) ? Woken::Signal : Woken::Timeout;
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t not_before = tick_ns + period_ns;
+    if ((int64_t)now.tv_sec * 1000000000ll + now.tv_nsec < not_before)
+    {
+      if (!loop_idle_)
+        ev_held_.fetch_add(1, std::memory_order_relaxed);
+      const timespec ts{(time_t)(not_before / 1000000000ll), (long)(not_before % 1000000000ll)};
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+      {
+      }
+    }
+    return why;
+  }
+
+  // after arming: references set since the tick read them (see wake())
+  bool referencesMoved_(const State &st)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (refs_.version() != refs_seen_)
+      return true;
+    for (std::size_t i = 0; i < kAxes; ++i)
+      if (robot_.axis(i).reference() != st.reference[i])
+        return true;
+    return false;
+  }
+
+  // An axis is quiet on a tick when its count and reference equal the
+  // previous tick's and its error is within tolerance; idle after 'settle'
+  // of quiet ticks. Any change makes it active on that same tick. The
+  // command is not compared: the integrator keeps moving it on a residual
+  // error until the axis is held (Robot::setHeld freezes it)
+  void detectIdle_(const State &st)
+  {
+    const auto &counts = robot_.lastSnapshot().counts;
+    const int64_t settle_ns = std::chrono::nanoseconds(idle_.settle).count();
+    uint32_t mask = 0;
+    for (std::size_t i = 0; i < kAxes; ++i)
+    {
+      const bool quiet = counts[i] == idle_counts_[i] && st.reference[i] == idle_ref_[i] &&
+                         std::fabs(st.reference[i] - st.position[i]) <= idle_.pos_tol_rev;
+      idle_counts_[i] = counts[i];
+      idle_ref_[i] = st.reference[i];
+      if (!quiet)
+        quiet_since_[i] = st.t_ns;
+      else if (st.t_ns - quiet_since_[i] >= settle_ns)
+        mask |= 1u << i;
+    }
+    if (mask != idle_mask_)
+      robot_.setHeld(mask, std::chrono::nanoseconds(idle_.refresh).count());
+    idle_mask_ = mask;
+
+    const bool all = mask == kAllAxes;
+    if (all == loop_idle_)
+      return;
+    loop_idle_ = all;
+    if (all)
+      idle_entries_.fetch_add(1, std::memory_order_relaxed);
+    // idle sleeps end on the first count; event mode goes back to its threshold
+    if (event_on_)
+      robot_.enableWake(all ? 1 : event_.threshold_counts);
+  }
+
+  // the time since the previous tick goes to the mode that tick left us in
+  void account_(int64_t dt_ns)
+  {
+    auto add = [dt_ns](std::atomic<uint64_t> &c) {
+      c.store(c.load(std::memory_order_relaxed) + (uint64_t)dt_ns, std::memory_order_relaxed);
+    };
+    add(loop_idle_ ? idle_ns_ : active_ns_);
+    for (std::size_t i = 0; i < kAxes; ++i)
+      if ((idle_mask_ >> i) & 1)
+        add(axis_idle_ns_[i]);
+  }
+
+  RobotT &robot_;
+  int prio_;
+  std::atomic<bool> running_{false};
+  std::atomic<int8_t> enable_req_{-1}; // requestEnable(); -1: none pending
+  std::thread th_;
+
+  ThreadMonitor monitor_{"control"};
+  OverloadManager overload_; // 1 kHz -> 500 Hz -> 250 Hz on sustained misses
+  TickProfiler profiler_;    // per-phase / per-axis tick timing
+  LatencyTrace trace_;       // edge -> decode -> PID -> bus write, per consumed edge
+  LatencyTrace::Writer *trace_writer_{nullptr};
+
+  EventMode event_;
+  bool event_on_{false};
+  EncoderWake *wake_{nullptr}; // owned by the robot; set in event or idle mode
+  std::atomic<uint64_t> ev_edge_{0}, ev_timeout_{0}, ev_immediate_{0}, ev_held_{0};
+
+  static constexpr uint32_t kAllAxes = (uint32_t)((1ull << kAxes) - 1);
+  IdleMode idle_;
+  bool idle_on_{false};
+  bool loop_idle_{false};
+  uint32_t idle_mask_{0};
+  std::array<int32_t, kAxes> idle_counts_{};
+  std::array<double, kAxes> idle_ref_{};
+  std::array<int64_t, kAxes> quiet_since_{};
+  std::atomic<uint64_t> active_ns_{0}, idle_ns_{0}, idle_entries_{0}, idle_wakes_{0};
+  std::array<std::atomic<uint64_t>, kAxes> axis_idle_ns_{};
+  uint32_t refs_seen_{0}; // 0: a batch set before the first tick lands on it
+
+  SeqLock<std::array<double, kAxes>> refs_;
+  SeqLock<State> state_;
+  SampleTap tap_;
+};
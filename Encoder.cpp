@@ -1,9 +1,13 @@
 #include "Encoder.h"
+#include "RtSentinel.h"
 #include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <stdexcept>
 #include <cstring>
 #include <cerrno>
 #include <ctime>
+#include <chrono>
 
 namespace
 {
@@ -11,6 +15,10 @@ namespace
   {
     return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
   }
+  inline int64_t to_ns(const timespec &ts)
+  {
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  }
   inline int readAB(gpiod_line *a, gpiod_line *b)
   {
     int va = gpiod_line_get_value(a);
@@ -26,9 +34,11 @@ namespace
       {0, -1, +1, 0}};
 }
 
-Encoder::Encoder(const char *chipPath, int a_line, int b_line, unsigned debounce_us)
-    : debounce_us_(debounce_us)
+Encoder::Encoder(const char *chipPath, int a_line, int b_line, unsigned debounce_us,
+                 EncoderSlot *slot)
+    : a_line_(a_line), b_line_(b_line), slot_(slot ? slot : &own_slot_)
 {
+  setDebounceRange(debounce_us, debounce_us);
   chip_ = gpiod_chip_open(chipPath);
   if (!chip_)
     throw std::runtime_error("gpiod_chip_open failed");
@@ -47,18 +57,24 @@ Encoder::Encoder(const char *chipPath, int a_line, int b_line, unsigned debounce
   int st = readAB(a_, b_);
   if (st < 0)
     throw std::runtime_error("initial AB read failed");
-  state_.store((uint8_t)st);
+  state_.store((uint8_t)st, std::memory_order_relaxed);
 
   a_fd_ = gpiod_line_event_get_fd(a_);
   b_fd_ = gpiod_line_event_get_fd(b_);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0)
+    throw std::runtime_error(std::string("eventfd: ") + std::strerror(errno));
   th_ = std::thread(&Encoder::worker_, this);
 }
 
 Encoder::~Encoder()
 {
   running_.store(false);
+  wakeWorker_();
   if (th_.joinable())
     th_.join();
+  if (wake_fd_ >= 0)
+    ::close(wake_fd_);
   if (a_)
     gpiod_line_release(a_);
   if (b_)
@@ -67,27 +83,113 @@ Encoder::~Encoder()
     gpiod_chip_close(chip_);
 }
 
-int32_t Encoder::count() const { return count_.load(); }
-uint32_t Encoder::illegal() const { return illegal_.load(); }
+int32_t Encoder::count() const { return slot_->count.load(std::memory_order_acquire); }
+uint32_t Encoder::illegal() const { return slot_->illegal.load(std::memory_order_relaxed); }
+Encoder::Mode Encoder::mode() const
+{
+  return mode_.load(std::memory_order_relaxed) == (uint8_t)Mode::Interrupt ? Mode::Interrupt : Mode::Sampling;
+}
+double Encoder::edgeRate() const { return edge_rate_.load(std::memory_order_relaxed); }
+void Encoder::setDebounceRange(unsigned min_us, unsigned max_us)
+{
+  for (auto &d : debounce_)
+    d.setRange(min_us * 1000u, max_us * 1000u);
+}
+
+void Encoder::debounceStats(int line, AdaptiveDebounce::Stats &out) const
+{
+  debounce_[line ? 1 : 0].stats(out);
+}
+
 void Encoder::zero()
 {
-  count_.store(0);
-  illegal_.store(0);
+  slot_->count.store(0, std::memory_order_release);
+  slot_->illegal.store(0, std::memory_order_relaxed);
+}
+
+void Encoder::applyLevels_(uint8_t neu)
+{
+  uint8_t old = state_.load(std::memory_order_relaxed);
+  int8_t d = qdelta[old][neu];
+  if (d == 0 && neu != old)
+  {
+    addIllegal_();
+  }
+  else if (d)
+  {
+    addCount_(d);
+  }
+  state_.store(neu, std::memory_order_relaxed);
+}
+
+void Encoder::wakeWorker_()
+{
+  const uint64_t one = 1;
+  if (wake_fd_ >= 0)
+    (void)!::write(wake_fd_, &one, sizeof(one));
+}
+
+void Encoder::flushEvents_()
+{
+  struct pollfd p[2] = {{a_fd_, POLLIN, 0}, {b_fd_, POLLIN, 0}};
+  gpiod_line_event stale;
+  while (poll(p, 2, 0) > 0)
+  {
+    if (p[0].revents & POLLIN)
+      gpiod_line_event_read(a_, &stale);
+    if (p[1].revents & POLLIN)
+      gpiod_line_event_read(b_, &stale);
+  }
 }
 
 void Encoder::worker_()
 {
-  // debounce timestamps per line
-  uint64_t last_a_us = 0, last_b_us = 0;
-  struct pollfd fds[2];
+  rt_sentinel::ThreadTag tag("encoder");
+  struct pollfd fds[3];
   fds[0].fd = a_fd_;
   fds[0].events = POLLIN;
   fds[1].fd = b_fd_;
   fds[1].events = POLLIN;
+  fds[2].fd = wake_fd_;
+  fds[2].events = POLLIN;
 
-  while (running_.load())
+  // edge-rate window for handing over to the sampler
+  const uint64_t rate_window_us = 20000;
+  uint64_t win_start_us = 0;
+  uint32_t win_edges = 0;
+  bool was_sampling = false;
+  int64_t resume_ns = 0; // queued events up to here were counted by the sampler
+  uint64_t wakes;
+
+  while (running_.load(std::memory_order_relaxed))
   {
-    int ret = poll(fds, 2, 100); // 100 ms timeout to check running flag
+    const uint8_t m = mode_.load(std::memory_order_acquire);
+    if (m != (uint8_t)Mode::Interrupt)
+    {
+      if (m == kReturnReq)
+      {
+        // the sampler counted everything queued so far; make room in the
+        // line FIFOs for the edges to replay after it lets go
+        flushEvents_();
+        uint8_t expect = kReturnReq;
+        mode_.compare_exchange_strong(expect, kReturnReady, std::memory_order_acq_rel);
+      }
+      // sampler owns the counts; sleep until it changes that
+      was_sampling = true;
+      poll(&fds[2], 1, 100);
+      (void)!::read(wake_fd_, &wakes, sizeof(wakes));
+      continue;
+    }
+    if (was_sampling)
+    {
+      // handed back: the sampler's state_ is current as of resume_ns_
+      resume_ns = resume_ns_.load(std::memory_order_relaxed);
+      win_start_us = 0;
+      win_edges = 0;
+      was_sampling = false;
+    }
+
+    int ret = poll(fds, 3, 100); // 100 ms timeout to check running flag
     if (ret < 0)
     {
       if (errno == EINTR)
@@ -96,6 +198,8 @@ void Encoder::worker_()
     }
     if (ret == 0)
       continue;
+    if (fds[2].revents & POLLIN)
+      (void)!::read(wake_fd_, &wakes, sizeof(wakes));
 
     for (int i = 0; i < 2; ++i)
     {
@@ -107,33 +211,46 @@ void Encoder::worker_()
       // read ONE event (bounded), rely on next poll to fetch more
       if (gpiod_line_event_read(ln, &ev) == 0)
       {
-        // debounce
-        uint64_t now_us = to_us(ev.ts);
-        uint64_t &last_us = (i == 0) ? last_a_us : last_b_us;
-        if (debounce_us_ && (now_us - last_us) < debounce_us_)
-        {
-          last_us = now_us;
+        const int64_t edge_ns = to_ns(ev.ts);
+        const uint64_t now_us = to_us(ev.ts);
+        if (edge_ns <= resume_ns)
+          continue; // already in the sampler's count
+        // debounce (window measured from the previous raw edge on the line)
+        if (debounce_[i].onEdge(edge_ns, debounce_[1 - i].lastEdge()))
           continue;
-        }
-        last_us = now_us;
 
         // robust: re-read both levels and apply quad table
+        timespec read_at;
+        clock_gettime(CLOCK_MONOTONIC, &read_at);
         int ns = readAB(a_, b_);
         if (ns < 0)
           continue;
-        uint8_t old = state_.load();
-        uint8_t neu = (uint8_t)ns;
-        int8_t d = qdelta[old][neu];
-        if (d == 0 && neu != old)
-        {
-          illegal_.fetch_add(1);
-        }
-        else if (d)
+        applyLevels_((uint8_t)ns);
+        // event timestamps are CLOCK_MONOTONIC (kernel >= 5.7)
+        timespec done;
+        clock_gettime(CLOCK_MONOTONIC, &done);
+        stampEdge_(edge_ns, to_ns(done));
+
+        // edge rate; hand over to the sampler when interrupts can't keep up
+        ++win_edges;
+        if (win_start_us == 0)
+          win_start_us = now_us;
+        if (now_us - win_start_us >= rate_window_us)
         {
-          count_.fetch_add(d);
+          const double rate = win_edges * 1e6 / (double)(now_us - win_start_us);
+          edge_rate_.store((float)rate, std::memory_order_relaxed);
+          win_start_us = now_us;
+          win_edges = 0;
+          const double up = up_eps_.load(std::memory_order_relaxed);
+          if (up > 0.0 && rate > up)
+          {
+            // last touch of state_: the sampler decodes from here on
+            handover_ns_.store(to_ns(read_at), std::memory_order_relaxed);
+            mode_.store((uint8_t)Mode::Sampling, std::memory_order_release);
+            break;
+          }
         }
-        state_.store(neu);
       }
     }
   }
-}
\ No newline at end of file
+}
@@ -1,15 +1,29 @@
 #pragma once
+#include "EncoderBank.h"
+#include "AdaptiveDebounce.h"
 #include <gpiod.h>
 #include <atomic>
 #include <cstdint>
 #include <thread>
 #include <string>
 
+class EncoderSampler;
+
 class Encoder
 {
 public:
+  // Who decodes the lines: the edge-event thread, or an EncoderSampler
+  enum class Mode : uint8_t
+  {
+    Interrupt = 0,
+    Sampling = 1
+  };
+
   // chipPath: "/dev/gpiochip0"; a_line/b_line: line offsets (e.g., 5 and 6)
-  Encoder(const char *chipPath, int a_line, int b_line, unsigned debounce_us = 5);
+  // debounce_us: fixed window on both lines until setDebounceRange
+  // slot: counters in an EncoderBank; nullptr keeps them inside the Encoder
+  Encoder(const char *chipPath, int a_line, int b_line, unsigned debounce_us = 5,
+          EncoderSlot *slot = nullptr);
   ~Encoder();
 
   // Counts are 4× quadrature counts
@@ -17,20 +31,60 @@ public:
   void zero();
   uint32_t illegal() const;
 
+  Mode mode() const;
+  double edgeRate() const; // edges/s over the last window of the active decoder
+  int lineA() const { return a_line_; }
+  int lineB() const { return b_line_; }
+
+  // let each line's debounce window follow its measured bounce and edge
+  // spacing within [min_us, max_us] (see AdaptiveDebounce); min == max: fixed.
+  // Interrupt decode only, the sampler filters by its sample period
+  void setDebounceRange(unsigned min_us, unsigned max_us);
+  // line 0: A, 1: B
+  void debounceStats(int line, AdaptiveDebounce::Stats &out) const;
+
 private:
+  friend class EncoderSampler;
+
   // worker thread waits on edge events and updates counts
   void worker_();
+  // read and drop every queued edge event of both lines
+  void flushEvents_();
+  void wakeWorker_();
+  // apply the step from state_ to 'levels' ((A<<1)|B); only the owner calls this
+  void applyLevels_(uint8_t levels);
+  void addCount_(int32_t d) { slot_->count.fetch_add(d, std::memory_order_release); }
+  void addIllegal_() { slot_->illegal.fetch_add(1, std::memory_order_relaxed); }
+  void stampEdge_(int64_t edge_ns, int64_t decoded_ns) { slot_->stampEdge(edge_ns, decoded_ns); }
 
   gpiod_chip *chip_{nullptr};
   gpiod_line *a_{nullptr};
   gpiod_line *b_{nullptr};
+  int a_line_, b_line_;
   int a_fd_{-1}, b_fd_{-1};
-  unsigned debounce_us_;
+  AdaptiveDebounce debounce_[2]; // A, B; written by the worker
   std::atomic<bool> running_{true};
   std::thread th_;
 
-  // state
-  std::atomic<int32_t> count_{0};
-  std::atomic<uint32_t> illegal_{0};
+  // state: hot counters live in *slot_ (own cache line); state_ is touched
+  // only by the current owner, handoffs synchronize through mode_
+  EncoderSlot own_slot_;
+  EncoderSlot *slot_;
   std::atomic<uint8_t> state_{0}; // (A<<1)|B
+
+  // decode ownership. The worker hands over by storing Sampling after its
+  // last decode (the store is its acknowledgement) with handover_ns_ stamped
+  // before its last level read; the sampler replays its samples from there.
+  // The sampler hands back in steps: ReturnReq; the worker flushes the
+  // events queued while sampled and acknowledges with ReturnReady; the
+  // sampler decodes one more sample and stores Interrupt with resume_ns_;
+  // the worker then replays the queued events stamped after resume_ns_.
+  static constexpr uint8_t kReturnReq = 2;
+  static constexpr uint8_t kReturnReady = 3;
+  std::atomic<uint8_t> mode_{(uint8_t)Mode::Interrupt};
+  std::atomic<int64_t> handover_ns_{0};
+  std::atomic<int64_t> resume_ns_{0};
+  int wake_fd_{-1}; // eventfd: sampler -> worker on ownership changes
+  std::atomic<double> up_eps_{0.0}; // 0: never hand over
+  std::atomic<float> edge_rate_{0.0f};
 };
\ No newline at end of file
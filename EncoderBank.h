@@ -0,0 +1,156 @@
+// EncoderBank.h
+#pragma once
+#include "EncoderWake.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Hot per-encoder counters, one cache line each so a decoder thread's writes
+// never invalidate another axis's line. Written only by the encoder's current
+// decoder, read by the control thread (acquire).
+struct alignas(64) EncoderSlot
+{
+  std::atomic<int32_t> count{0};
+  std::atomic<uint32_t> illegal{0};
+  // newest decoded edge (CLOCK_MONOTONIC; the kernel's event timestamp in
+  // interrupt mode, the sample time when sampled) and how long after it the
+  // count was updated; stamped after the count, see stampEdge()
+  std::atomic<int32_t> decode_lag_ns{0};
+  std::atomic<int64_t> edge_ns{0};
+
+  void stampEdge(int64_t edge, int64_t decoded)
+  {
+    const int64_t lag = decoded - edge;
+    decode_lag_ns.store(lag < 0 ? 0 : lag > INT32_MAX ? INT32_MAX : (int32_t)lag,
+                        std::memory_order_relaxed);
+    edge_ns.store(edge, std::memory_order_release);
+    notify();
+  }
+
+  // after a count update, from the decoder. The fence orders the count
+  // update before the armed() load; it pairs with the one in
+  // EncoderBank::armWake, so an edge is never missed by both sides
+  void notify()
+  {
+    EncoderWake *w = arm.wake.load(std::memory_order_relaxed);
+    if (!w)
+      return;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!w->armed())
+      return;
+    const int32_t d = count.load(std::memory_order_relaxed) - arm.base.load(std::memory_order_relaxed);
+    const int32_t th = arm.threshold.load(std::memory_order_relaxed);
+    if (d >= th || d <= -th)
+      w->signal();
+  }
+
+  // event-triggered control: signal 'wake' once |count - base| reaches
+  // threshold. Written by the control thread every tick, so on its own line
+  struct alignas(64) Arm
+  {
+    std::atomic<int32_t> base{0};
+    std::atomic<int32_t> threshold{0};
+    std::atomic<EncoderWake *> wake{nullptr};
+  } arm;
+};
+static_assert(sizeof(EncoderSlot) == 128, "EncoderSlot: one line of counters, one of wake arming");
+
+template <std::size_t N>
+struct EncoderSnapshot
+{
+  std::array<int32_t, N> counts;
+  int64_t t_ns;    // CLOCK_MONOTONIC, midpoint of the read
+  int64_t skew_ns; // time between first and last slot read
+  // newest edge already included in counts (0: none yet) and its decode lag
+  std::array<int64_t, N> edge_ns;
+  std::array<int32_t, N> decode_lag_ns;
+};
+
+// Fixed set of encoder slots with a single-instant read of all axes.
+//
+// Each slot has its own writer, so the set cannot be read atomically as a
+// whole; snapshotAll() instead loads every slot back-to-back inside a
+// timestamped window and retries when it was stretched (preempted), so all
+// counts belong to the same instant within max_skew_ns.
+template <std::size_t N>
+class EncoderBank
+{
+public:
+  static constexpr std::size_t size() { return N; }
+
+  EncoderSlot &operator[](std::size_t i) { return slots_[i]; }
+  const EncoderSlot &operator[](std::size_t i) const { return slots_[i]; }
+
+  EncoderSnapshot<N> snapshotAll(int64_t max_skew_ns = 2000) const
+  {
+    EncoderSnapshot<N> s;
+    // Edge stamps first: a stamp is stored after its count, so every edge
+    // seen here is in the counts read below (a newer one may be too; its
+    // latency is then attributed to the older stamp, never underestimated)
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      s.edge_ns[i] = slots_[i].edge_ns.load(std::memory_order_acquire);
+      s.decode_lag_ns[i] = slots_[i].decode_lag_ns.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slots_[i].edge_ns.load(std::memory_order_relaxed) != s.edge_ns[i])
+        s.decode_lag_ns[i] = -1; // restamped meanwhile: lag unknown
+    }
+    for (int attempt = 0;; ++attempt)
+    {
+      const int64_t t0 = now_ns();
+      for (std::size_t i = 0; i < N; ++i)
+        s.counts[i] = slots_[i].count.load(std::memory_order_acquire);
+      const int64_t t1 = now_ns();
+      s.t_ns = t0 + (t1 - t0) / 2;
+      s.skew_ns = t1 - t0;
+      if (s.skew_ns <= max_skew_ns || attempt == 2)
+        return s;
+    }
+  }
+
+  // Event-triggered control: decoders signal 'w' once an axis has moved
+  // threshold counts from the base set by armWake() (nullptr: off)
+  void setWake(EncoderWake *w, int32_t threshold)
+  {
+    for (auto &sl : slots_)
+    {
+      sl.arm.threshold.store(threshold < 1 ? 1 : threshold, std::memory_order_relaxed);
+      sl.arm.wake.store(w, std::memory_order_relaxed);
+    }
+  }
+
+  // Set the bases to the counts just used and arm the wake. false if an axis
+  // is already past the threshold (an edge came in meanwhile): don't sleep.
+  // The fence between arm and count re-check pairs with the one in
+  // EncoderSlot::notify(), so an edge is never missed by both sides.
+  bool armWake(EncoderWake &w, const std::array<int32_t, N> &base)
+  {
+    for (std::size_t i = 0; i < N; ++i)
+      slots_[i].arm.base.store(base[i], std::memory_order_relaxed);
+    w.arm();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      const int32_t d = slots_[i].count.load(std::memory_order_relaxed) - base[i];
+      const int32_t th = slots_[i].arm.threshold.load(std::memory_order_relaxed);
+      if (d >= th || d <= -th)
+      {
+        w.disarm();
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  static int64_t now_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  }
+
+  std::array<EncoderSlot, N> slots_{};
+};
@@ -0,0 +1,351 @@
+// EncoderSampler.cpp
+#include "EncoderSampler.h"
+#include "Encoder.h"
+#include "util.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+  constexpr size_t kGpioMapSize = 4096;
+  constexpr size_t kGplev0Offset = 0x34; // GPIO pin level 0 register
+
+  inline int64_t now_ns()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  }
+}
+
+// ---------------- GpiodBulkSource ----------------
+
+void GpiodBulkSource::addLine(gpiod_line *line, unsigned offset)
+{
+  if (!line || offset >= 32)
+    throw std::invalid_argument("GpiodBulkSource: line offset must be 0..31");
+  gpiod_chip *chip = gpiod_line_get_chip(line);
+  int g = 0;
+  while (g < groups_ && chip_[g] != chip)
+    ++g;
+  if (g == groups_)
+  {
+    if (groups_ == kMaxGroups)
+      throw std::runtime_error("GpiodBulkSource: too many chip handles");
+    chip_[g] = chip;
+    gpiod_line_bulk_init(&bulk_[g]);
+    ++groups_;
+  }
+  if (bulk_[g].num_lines >= GPIOD_LINE_BULK_MAX_LINES)
+    throw std::runtime_error("GpiodBulkSource: too many lines");
+  offsets_[g][bulk_[g].num_lines] = offset;
+  gpiod_line_bulk_add(&bulk_[g], line);
+}
+
+bool GpiodBulkSource::read(uint32_t &levels)
+{
+  int vals[GPIOD_LINE_BULK_MAX_LINES];
+  uint32_t w = 0;
+  for (int g = 0; g < groups_; ++g)
+  {
+    if (gpiod_line_get_value_bulk(&bulk_[g], vals) < 0)
+      return false;
+    for (unsigned i = 0; i < bulk_[g].num_lines; ++i)
+      w |= (vals[i] ? 1u : 0u) << offsets_[g][i];
+  }
+  levels = w;
+  return true;
+}
+
+// ---------------- GpioMemSource ----------------
+
+GpioMemSource::GpioMemSource(const char *path)
+{
+  fd_ = ::open(path, O_RDONLY | O_SYNC);
+  if (fd_ < 0)
+    throw std::runtime_error(std::string("open ") + path + ": " + std::strerror(errno));
+  map_ = mmap(nullptr, kGpioMapSize, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED)
+  {
+    map_ = nullptr;
+    ::close(fd_);
+    throw std::runtime_error(std::string("mmap ") + path + ": " + std::strerror(errno));
+  }
+  lev0_ = reinterpret_cast<const volatile uint32_t *>(
+      static_cast<const char *>(map_) + kGplev0Offset);
+}
+
+GpioMemSource::~GpioMemSource()
+{
+  if (map_)
+    munmap(map_, kGpioMapSize);
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+bool GpioMemSource::read(uint32_t &levels)
+{
+  levels = *lev0_;
+  return true;
+}
+
+// ---------------- FileLevelSource ----------------
+
+FileLevelSource::FileLevelSource(const char *path)
+{
+  fd_ = ::open(path, O_RDONLY);
+  if (fd_ < 0)
+    throw std::runtime_error(std::string("open ") + path + ": " + std::strerror(errno));
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+  {
+    ::close(fd_);
+    throw std::runtime_error(std::string("fstat ") + path + ": " + std::strerror(errno));
+  }
+  n_ = (size_t)st.st_size / sizeof(uint32_t);
+  if (n_ == 0)
+    return;
+  map_ = mmap(nullptr, n_ * sizeof(uint32_t), PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (map_ == MAP_FAILED)
+  {
+    map_ = nullptr;
+    ::close(fd_);
+    throw std::runtime_error(std::string("mmap ") + path + ": " + std::strerror(errno));
+  }
+  words_ = static_cast<const uint32_t *>(map_);
+}
+
+FileLevelSource::~FileLevelSource()
+{
+  if (map_)
+    munmap(map_, n_ * sizeof(uint32_t));
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+bool FileLevelSource::read(uint32_t &levels)
+{
+  if (pos_ >= n_)
+    return false;
+  levels = words_[pos_++];
+  return true;
+}
+
+// ---------------- QuadDecoder ----------------
+
+int QuadDecoder::add(unsigned a_bit, unsigned b_bit)
+{
+  if (n_ == kMaxChannels)
+    throw std::runtime_error("QuadDecoder: too many channels");
+  if (a_bit >= 32 || b_bit >= 32)
+    throw std::invalid_argument("QuadDecoder: bit index must be 0..31");
+  a_bit_[n_] = (uint8_t)a_bit;
+  b_bit_[n_] = (uint8_t)b_bit;
+  return n_++;
+}
+
+// ---------------- EncoderSampler ----------------
+
+EncoderSampler::EncoderSampler(std::unique_ptr<GpioLevelSource> src, const Params &p)
+    : src_(std::move(src)), params_(p)
+{
+  if (!src_)
+    throw std::invalid_argument("EncoderSampler: null level source");
+  if (params_.down_eps >= params_.up_eps)
+    throw std::invalid_argument("EncoderSampler: down_eps must be below up_eps");
+}
+
+EncoderSampler::~EncoderSampler() { stop(); }
+
+void EncoderSampler::attach(Encoder &enc)
+{
+  if (running_.load())
+    throw std::logic_error("EncoderSampler::attach after start");
+  const int ch = dec_.add((unsigned)enc.lineA(), (unsigned)enc.lineB());
+  src_->addLine(enc.a_, (unsigned)enc.lineA());
+  src_->addLine(enc.b_, (unsigned)enc.lineB());
+  enc_[ch] = &enc;
+  enc.up_eps_.store(params_.up_eps);
+}
+
+void EncoderSampler::start()
+{
+  if (running_.exchange(true))
+    return;
+  th_ = std::thread(&EncoderSampler::worker_, this);
+}
+
+void EncoderSampler::stop()
+{
+  running_.store(false);
+  if (th_.joinable())
+    th_.join();
+  // give every encoder back to its interrupt thread, which replays what
+  // its line FIFOs still hold from after the last sample
+  for (int ch = 0; ch < dec_.size(); ++ch)
+  {
+    Encoder &e = *enc_[ch];
+    e.up_eps_.store(0.0);
+    if (e.mode_.load(std::memory_order_acquire) == (uint8_t)Encoder::Mode::Interrupt)
+      continue;
+    e.resume_ns_.store(last_t_, std::memory_order_relaxed);
+    e.mode_.store((uint8_t)Encoder::Mode::Interrupt, std::memory_order_release);
+    e.wakeWorker_();
+  }
+}
+
+void EncoderSampler::worker_()
+{
+  if (params_.cpu >= 0)
+  {
+    try { pin_to_cpu(params_.cpu); } catch (...) {}
+  }
+  try { set_realtime(params_.prio); } catch (...) {}
+  rt_sentinel::ThreadTag tag("sampler");
+
+  const int n = dec_.size();
+  uint32_t lv = 0;
+  while (!src_->read(lv))
+  {
+    read_errors_.fetch_add(1, std::memory_order_relaxed);
+    if (!running_.load() || src_->exhausted())
+      return;
+  }
+  dec_.reset(lv);
+
+  const int64_t period_ns = params_.period.count();
+  const int64_t window_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(params_.rate_window).count();
+  uint32_t owned = 0;
+  uint32_t releasing = 0; // hand-backs acknowledged before this sample's read
+  uint32_t fresh = 0;     // taken during the current rate window
+  uint32_t edges[QuadDecoder::kMaxChannels] = {};
+  uint64_t hist_n = 0;
+  int64_t prev_t = now_ns();
+  int64_t win_start = prev_t;
+  timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (running_.load(std::memory_order_relaxed))
+  {
+    if (!src_->read(lv))
+    {
+      read_errors_.fetch_add(1, std::memory_order_relaxed);
+      if (src_->exhausted())
+        break; // replay finished
+      continue;
+    }
+    const int64_t t = now_ns(); // sample time: edge stamp and rate window
+    samples_.fetch_add(1, std::memory_order_relaxed);
+    const QuadStep s = dec_.step(lv);
+    hist_[hist_n % kHistory] = {t, lv};
+    ++hist_n;
+
+    // ownership: encoders hand themselves over from their event thread
+    uint32_t now_owned = 0, ready = 0;
+    for (int ch = 0; ch < n; ++ch)
+    {
+      const uint8_t m = enc_[ch]->mode_.load(std::memory_order_acquire);
+      if (m != (uint8_t)Encoder::Mode::Interrupt)
+        now_owned |= 1u << ch;
+      if (m == Encoder::kReturnReady)
+        ready |= 1u << ch;
+    }
+    const uint32_t taken = now_owned & ~owned;
+    owned = now_owned;
+    if (taken)
+      handovers_.fetch_add(__builtin_popcount(taken), std::memory_order_relaxed);
+    fresh |= taken;
+
+    // newly owned: continue from the worker's last level read, replaying
+    // every sample stamped after it (the oldest kept one if it is older)
+    for (uint32_t m = taken; m; m &= m - 1)
+    {
+      const int ch = __builtin_ctz(m);
+      Encoder &e = *enc_[ch];
+      const int64_t from = e.handover_ns_.load(std::memory_order_relaxed);
+      const uint64_t oldest = hist_n > (uint64_t)kHistory ? hist_n - kHistory : 0;
+      uint64_t i = hist_n - 1;
+      while (i > oldest && hist_[(i - 1) % kHistory].t > from)
+        --i;
+      for (; i < hist_n; ++i)
+        e.applyLevels_(dec_.state(hist_[i % kHistory].levels, ch));
+      edges[ch] = 0;
+    }
+
+    // decode result for owned channels straight from the bit-parallel masks
+    const uint32_t moved = (s.inc | s.dec | s.bad) & owned & ~taken;
+    const int64_t decoded = moved ? now_ns() : 0;
+    for (uint32_t m = moved; m; m &= m - 1)
+    {
+      const int ch = __builtin_ctz(m);
+      const uint32_t bit = 1u << ch;
+      Encoder &e = *enc_[ch];
+      if (s.bad & bit)
+        e.addIllegal_();
+      else
+        e.addCount_((s.inc & bit) ? 1 : -1);
+      e.state_.store(dec_.state(ch), std::memory_order_relaxed);
+      e.stampEdge_(t, decoded);
+      ++edges[ch];
+    }
+
+    // hand back: this sample was read after the worker flushed, so it holds
+    // every edge the worker dropped and every one stamped up to prev_t
+    for (uint32_t m = releasing & owned; m; m &= m - 1)
+    {
+      const int ch = __builtin_ctz(m);
+      Encoder &e = *enc_[ch];
+      e.resume_ns_.store(prev_t, std::memory_order_relaxed);
+      e.mode_.store((uint8_t)Encoder::Mode::Interrupt, std::memory_order_release);
+      e.wakeWorker_();
+      owned &= ~(1u << ch);
+      handovers_.fetch_add(1, std::memory_order_relaxed);
+    }
+    releasing = ready & owned;
+
+    // edge rate per owned encoder; ask to hand back when it has slowed down
+    if (t - win_start >= window_ns)
+    {
+      const double secs = (double)(t - win_start) * 1e-9;
+      for (uint32_t m = owned; m; m &= m - 1)
+      {
+        const int ch = __builtin_ctz(m);
+        Encoder &e = *enc_[ch];
+        const double rate = edges[ch] / secs;
+        edges[ch] = 0;
+        if (fresh & (1u << ch))
+          continue; // counted over part of the window only
+        e.edge_rate_.store((float)rate);
+        if (rate < params_.down_eps &&
+            e.mode_.load(std::memory_order_relaxed) == (uint8_t)Encoder::Mode::Sampling)
+        {
+          e.mode_.store(Encoder::kReturnReq, std::memory_order_release);
+          e.wakeWorker_();
+        }
+      }
+      fresh = 0;
+      win_start = t;
+    }
+    prev_t = t;
+
+    if (period_ns > 0)
+    {
+      next.tv_nsec += period_ns;
+      while (next.tv_nsec >= 1000000000l)
+      {
+        next.tv_nsec -= 1000000000l;
+        ++next.tv_sec;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+  }
+  last_t_ = prev_t;
+}
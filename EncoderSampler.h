@@ -0,0 +1,206 @@
+// EncoderSampler.h
+#pragma once
+#include <gpiod.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+class Encoder;
+
+// Raw GPIO levels for one sample: bit n = level of line offset n (0..31)
+class GpioLevelSource
+{
+public:
+  virtual ~GpioLevelSource() = default;
+  // false on read error or end of data
+  virtual bool read(uint32_t &levels) = 0;
+  // true once a finite source (replay) has no more samples
+  virtual bool exhausted() const { return false; }
+  // called for every encoder line the sampler will decode
+  virtual void addLine(gpiod_line *line, unsigned offset)
+  {
+    (void)line;
+    (void)offset;
+  }
+};
+
+// gpiod_line_get_value_bulk over the encoders' already-requested lines.
+// Lines are grouped by chip handle; libgpiod v1 still does one ioctl per
+// event-requested line, so prefer GpioMemSource when it is available.
+class GpiodBulkSource : public GpioLevelSource
+{
+public:
+  bool read(uint32_t &levels) override;
+  void addLine(gpiod_line *line, unsigned offset) override;
+
+private:
+  static constexpr int kMaxGroups = 8;
+  gpiod_line_bulk bulk_[kMaxGroups];
+  unsigned offsets_[kMaxGroups][GPIOD_LINE_BULK_MAX_LINES];
+  gpiod_chip *chip_[kMaxGroups]{};
+  int groups_{0};
+};
+
+// Read-only mmap of the BCM283x/BCM2711 GPIO block (/dev/gpiomem);
+// one load of GPLEV0 returns every bank-0 level. Not for the Pi 5 (RP1).
+class GpioMemSource : public GpioLevelSource
+{
+public:
+  explicit GpioMemSource(const char *path = "/dev/gpiomem");
+  ~GpioMemSource() override;
+  bool read(uint32_t &levels) override;
+
+private:
+  int fd_{-1};
+  void *map_{nullptr};
+  const volatile uint32_t *lev0_{nullptr};
+};
+
+// Test fake: a file of native-endian uint32 level words, one per sample,
+// mapped read-only and replayed in order; read() fails at end of file.
+class FileLevelSource : public GpioLevelSource
+{
+public:
+  explicit FileLevelSource(const char *path);
+  ~FileLevelSource() override;
+  bool read(uint32_t &levels) override;
+  bool exhausted() const override { return pos_ >= n_; }
+  size_t size() const { return n_; }
+
+private:
+  int fd_{-1};
+  void *map_{nullptr};
+  const uint32_t *words_{nullptr};
+  size_t n_{0};
+  size_t pos_{0};
+};
+
+// Per-sample result, bit i = channel i
+struct QuadStep
+{
+  uint32_t inc; // +1 count
+  uint32_t dec; // -1 count
+  uint32_t bad; // both lines changed (illegal)
+};
+
+// Bit-parallel quadrature decoder for up to 32 channels sharing one level word.
+// Same direction convention as Encoder's state table: state = (A<<1)|B.
+class QuadDecoder
+{
+public:
+  static constexpr int kMaxChannels = 32;
+
+  // returns the channel index
+  int add(unsigned a_bit, unsigned b_bit);
+  int size() const { return n_; }
+
+  // pack channel levels: bit i of a/b = A/B level of channel i
+  void gather(uint32_t levels, uint32_t &a, uint32_t &b) const
+  {
+    uint32_t ra = 0, rb = 0;
+    for (int i = 0; i < n_; ++i)
+    {
+      ra |= ((levels >> a_bit_[i]) & 1u) << i;
+      rb |= ((levels >> b_bit_[i]) & 1u) << i;
+    }
+    a = ra;
+    b = rb;
+  }
+
+  // one step for all channels against the previous packed levels
+  static QuadStep kernel(uint32_t pa, uint32_t pb, uint32_t a, uint32_t b)
+  {
+    const uint32_t ca = pa ^ a, cb = pb ^ b, x = a ^ b;
+    const uint32_t only_a = ca & ~cb, only_b = cb & ~ca;
+    return {(only_b & x) | (only_a & ~x), (only_b & ~x) | (only_a & x), ca & cb};
+  }
+
+  void reset(uint32_t levels) { gather(levels, pa_, pb_); }
+  QuadStep step(uint32_t levels)
+  {
+    uint32_t a, b;
+    gather(levels, a, b);
+    const QuadStep s = kernel(pa_, pb_, a, b);
+    pa_ = a;
+    pb_ = b;
+    return s;
+  }
+  // (A<<1)|B of channel ch at the last sample
+  uint8_t state(int ch) const
+  {
+    return (uint8_t)((((pa_ >> ch) & 1u) << 1) | ((pb_ >> ch) & 1u));
+  }
+  // (A<<1)|B of channel ch in a raw level word
+  uint8_t state(uint32_t levels, int ch) const
+  {
+    return (uint8_t)((((levels >> a_bit_[ch]) & 1u) << 1) | ((levels >> b_bit_[ch]) & 1u));
+  }
+
+private:
+  uint8_t a_bit_[kMaxChannels]{};
+  uint8_t b_bit_[kMaxChannels]{};
+  int n_{0};
+  uint32_t pa_{0}, pb_{0};
+};
+
+// Decodes many encoders from one level word per sample, at a fixed high rate
+// on a dedicated (ideally isolated) core.
+//
+// Attached encoders start in interrupt mode. Each one hands itself over when
+// its interrupt-side edge rate exceeds up_eps, and the sampler hands it back
+// once its sampled edge rate drops below down_eps. Only the current owner
+// writes the encoder's count. On hand-over the sampler replays its recent
+// samples from the worker's last level read; on hand-back it waits for the
+// worker to flush its stale events and lets it replay the newer ones (see
+// Encoder::mode_), so no edge is lost or counted twice either way.
+class EncoderSampler
+{
+public:
+  struct Params
+  {
+    std::chrono::nanoseconds period{std::chrono::microseconds(5)}; // 0 = busy-poll
+    int cpu{-1};                                                  // core to pin to (-1: no pinning)
+    int prio{85};                                                 // SCHED_FIFO priority
+    double up_eps{20000.0};                                       // edges/s per encoder: go to sampling
+    double down_eps{5000.0};                                      // edges/s per encoder: back to interrupts
+    std::chrono::milliseconds rate_window{20};                    // edge-rate measurement window
+  };
+
+  EncoderSampler(std::unique_ptr<GpioLevelSource> src, const Params &p);
+  ~EncoderSampler();
+
+  // before start(); the encoder must outlive the sampler's thread
+  void attach(Encoder &enc);
+  void start();
+  void stop();
+
+  uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+  uint64_t readErrors() const { return read_errors_.load(std::memory_order_relaxed); }
+  uint64_t handovers() const { return handovers_.load(std::memory_order_relaxed); }
+
+private:
+  // recent samples, to replay from on hand-over (~1.3 ms at 5 us)
+  static constexpr int kHistory = 256;
+  struct Sample
+  {
+    int64_t t; // CLOCK_MONOTONIC after the read
+    uint32_t levels;
+  };
+
+  void worker_();
+
+  std::unique_ptr<GpioLevelSource> src_;
+  Params params_;
+  QuadDecoder dec_;
+  Encoder *enc_[QuadDecoder::kMaxChannels]{};
+  Sample hist_[kHistory];
+  int64_t last_t_{0}; // newest sample, for stop()
+
+  std::atomic<bool> running_{false};
+  std::thread th_;
+  std::atomic<uint64_t> samples_{0};
+  std::atomic<uint64_t> read_errors_{0};
+  std::atomic<uint64_t> handovers_{0};
+};
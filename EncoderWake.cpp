@@ -0,0 +1,56 @@
+// EncoderWake.cpp
+#include "EncoderWake.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EncoderWake::EncoderWake()
+{
+  fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd_ < 0)
+    throw std::runtime_error(std::string("eventfd: ") + std::strerror(errno));
+}
+
+EncoderWake::~EncoderWake()
+{
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+void EncoderWake::post_()
+{
+  const uint64_t one = 1;
+  if (write(fd_, &one, sizeof(one)) == sizeof(one))
+    posts_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool EncoderWake::waitUntil(int64_t deadline_ns)
+{
+  struct pollfd p;
+  p.fd = fd_;
+  p.events = POLLIN;
+  for (;;)
+  {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t left = deadline_ns - ((int64_t)now.tv_sec * 1000000000ll + now.tv_nsec);
+    if (left <= 0)
+      break;
+    const timespec to{(time_t)(left / 1000000000ll), (long)(left % 1000000000ll)};
+    const int r = ppoll(&p, 1, &to, nullptr);
+    if (r > 0)
+      break;
+    if (r == 0 || errno != EINTR)
+      break;
+  }
+  // consume the post (if any) so the next wait blocks again
+  uint64_t v;
+  const bool signalled = read(fd_, &v, sizeof(v)) == sizeof(v);
+  armed_.store(false, std::memory_order_relaxed);
+  return signalled;
+}
@@ -0,0 +1,44 @@
+// EncoderWake.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Wakes a sleeping control thread from the encoder decode path
+// (event-triggered control, see ControlLoop::setEventMode).
+//
+// The waiter arm()s before sleeping; the first signal() after that posts
+// one eventfd write. Decoders check armed() first, so edges while the
+// waiter is busy cost a load.
+class EncoderWake
+{
+public:
+  EncoderWake();
+  ~EncoderWake();
+  EncoderWake(const EncoderWake &) = delete;
+  EncoderWake &operator=(const EncoderWake &) = delete;
+
+  // --- decoder threads ---
+  // check armed() first: once it reads true, the waiter's bases are visible
+  bool armed() const { return armed_.load(std::memory_order_seq_cst); }
+  void signal()
+  {
+    if (armed_.exchange(false, std::memory_order_seq_cst))
+      post_();
+  }
+
+  // --- the waiting thread ---
+  // the caller fences between arm() and its re-check, pairing with the
+  // decoder's fence before armed() (EncoderBank::armWake, EncoderSlot::notify)
+  void arm() { armed_.store(true, std::memory_order_seq_cst); }
+  void disarm() { armed_.store(false, std::memory_order_relaxed); }
+  // sleep until signalled or deadline_ns (CLOCK_MONOTONIC); true if signalled
+  bool waitUntil(int64_t deadline_ns);
+
+  uint64_t posts() const { return posts_.load(std::memory_order_relaxed); }
+
+private:
+  void post_();
+  int fd_{-1};
+  std::atomic<bool> armed_{false};
+  std::atomic<uint64_t> posts_{0};
+};
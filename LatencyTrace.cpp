@@ -0,0 +1,149 @@
+// LatencyTrace.cpp
+#include "LatencyTrace.h"
+#include <algorithm>
+#include <cstdio>
+
+LatencyTrace::LatencyTrace()
+{
+  for (auto &w : window_)
+    w.reserve(8192);
+}
+
+LatencyTrace::~LatencyTrace() = default;
+
+LatencyTrace::Writer *LatencyTrace::writer(const char *name)
+{
+  std::lock_guard<std::mutex> lk(reg_m_);
+  const std::size_t i = n_writers_.load(std::memory_order_relaxed);
+  if (i >= kMaxWriters)
+    return nullptr;
+  owned_.emplace_back(new Writer(name, (uint16_t)i));
+  writers_[i].store(owned_.back().get(), std::memory_order_release);
+  n_writers_.store(i + 1, std::memory_order_release);
+  return owned_.back().get();
+}
+
+void LatencyTrace::setExport(std::size_t max_records)
+{
+  std::lock_guard<std::mutex> lk(m_);
+  export_max_ = max_records;
+  export_.reserve(max_records);
+}
+
+void LatencyTrace::drain()
+{
+  std::lock_guard<std::mutex> lk(m_);
+  const std::size_t n = n_writers_.load(std::memory_order_acquire);
+  Record r;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    Writer *w = writers_[i].load(std::memory_order_acquire);
+    while (w->ring_.pop(r))
+    {
+      if (r.decode_ns)
+      {
+        window_[(int)Stage::Decode].push_back(r.decode_ns - r.edge_ns);
+        window_[(int)Stage::Wait].push_back(r.sample_ns - r.decode_ns);
+      }
+      window_[(int)Stage::Pid].push_back(r.pid_ns - r.sample_ns);
+      window_[(int)Stage::Bus].push_back(r.bus_ns - r.pid_ns);
+      window_[(int)Stage::Total].push_back(r.bus_ns - r.edge_ns);
+      if (export_.size() < export_max_)
+        export_.push_back(r);
+    }
+  }
+}
+
+void LatencyTrace::snapshot_reset(Summary &out)
+{
+  drain();
+  std::lock_guard<std::mutex> lk(m_);
+  for (std::size_t s = 0; s < kStages; ++s)
+  {
+    std::vector<int64_t> &v = window_[s];
+    Stat &st = out.s[s];
+    st = Stat{};
+    st.n = v.size();
+    if (!v.empty())
+    {
+      // nearest-rank percentiles
+      auto at = [&](double q) {
+        const std::size_t k = std::min(v.size() - 1, (std::size_t)(q * (double)v.size()));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return (double)v[k] / 1000.0;
+      };
+      st.p50_us = at(0.50);
+      st.p90_us = at(0.90);
+      st.p99_us = at(0.99);
+      st.max_us = (double)*std::max_element(v.begin(), v.end()) / 1000.0;
+    }
+    v.clear();
+  }
+  out.dropped = 0;
+  const std::size_t n = n_writers_.load(std::memory_order_acquire);
+  for (std::size_t i = 0; i < n; ++i)
+    out.dropped += writers_[i].load(std::memory_order_acquire)->dropped_.load(std::memory_order_relaxed);
+}
+
+// Trace Event Format: one complete ("X") event per stage, one track per
+// axis and writer; timestamps in us
+bool LatencyTrace::writeChromeTrace(const std::string &path)
+{
+  drain();
+  std::lock_guard<std::mutex> lk(m_);
+  FILE *f = std::fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  const std::size_t n = n_writers_.load(std::memory_order_acquire);
+  bool first = true;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    std::fprintf(f, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", i, writers_[i].load(std::memory_order_acquire)->name_);
+    first = false;
+  }
+  uint32_t axes = 0;
+  for (const Record &r : export_)
+  {
+    if (r.axis < 32 && !(axes & (1u << r.axis)))
+    {
+      axes |= 1u << r.axis;
+      for (std::size_t i = 0; i < n; ++i)
+        std::fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%zu,\"tid\":%u,\"args\":{\"name\":\"axis %u\"}}",
+                     i, (unsigned)r.axis, (unsigned)r.axis);
+    }
+    const int64_t t[5] = {r.edge_ns, r.decode_ns ? r.decode_ns : r.sample_ns, r.sample_ns, r.pid_ns, r.bus_ns};
+    const char *names[4] = {r.decode_ns ? "decode" : "edge->read", "wait", "pid", "bus"};
+    for (int s = 0; s < 4; ++s)
+    {
+      if (s == 1 && !r.decode_ns)
+        continue;
+      std::fprintf(f, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"args\":{\"tick\":%llu}}",
+                   names[s], (unsigned)r.writer, (unsigned)r.axis, (double)t[s] / 1000.0,
+                   (double)(t[s + 1] - t[s]) / 1000.0, (unsigned long long)r.tick);
+    }
+  }
+  std::fprintf(f, "\n]}\n");
+  return std::fclose(f) == 0;
+}
+
+const char *LatencyTrace::stageName(Stage s)
+{
+  switch (s)
+  {
+  case Stage::Decode:
+    return "decode";
+  case Stage::Wait:
+    return "wait";
+  case Stage::Pid:
+    return "pid";
+  case Stage::Bus:
+    return "bus";
+  case Stage::Total:
+    return "total";
+  default:
+    return "?";
+  }
+}
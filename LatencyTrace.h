@@ -0,0 +1,113 @@
+// LatencyTrace.h
+#pragma once
+#include "Ring.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Edge-to-actuation latency: for every encoder edge a control tick consumes,
+// when it happened (kernel timestamp), when it was decoded, when the tick
+// read it, when PID::step finished and when that axis's Motoron write
+// returned. All times CLOCK_MONOTONIC ns.
+//
+// Each producing thread gets its own lock-free ring (writer()); housekeeping
+// drains them all, keeps per-stage distributions for snapshot_reset() and,
+// if enabled, the records for a Chrome trace export (chrome://tracing,
+// Perfetto: writeChromeTrace()).
+class LatencyTrace
+{
+public:
+  struct Record
+  {
+    uint64_t tick;
+    int64_t edge_ns;
+    int64_t decode_ns; // 0: unknown (restamped while read)
+    int64_t sample_ns; // encoder snapshot of the tick
+    int64_t pid_ns;    // after PID::step
+    int64_t bus_ns;    // after the axis's Motoron write returned
+    uint16_t axis;
+    uint16_t writer;
+  };
+
+  enum class Stage : uint8_t
+  {
+    Decode, // edge -> count updated
+    Wait,   // count updated -> read by the tick
+    Pid,    // read -> PID done
+    Bus,    // PID done -> write returned
+    Total,  // edge -> write returned
+    Count
+  };
+  static constexpr std::size_t kStages = (std::size_t)Stage::Count;
+  static constexpr std::size_t kMaxWriters = 4;
+
+  // one per producing thread
+  class Writer
+  {
+  public:
+    // false (and counted) when housekeeping has fallen behind
+    bool push(const Record &r)
+    {
+      if (ring_.push(r))
+        return true;
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    uint16_t id() const { return id_; }
+
+  private:
+    friend class LatencyTrace;
+    Writer(const char *name, uint16_t id) : name_(name), id_(id) {}
+    const char *name_;
+    uint16_t id_;
+    SpscRing<Record, 4096> ring_;
+    std::atomic<uint64_t> dropped_{0};
+  };
+
+  struct Stat
+  {
+    uint64_t n{0};
+    double p50_us{0}, p90_us{0}, p99_us{0}, max_us{0};
+  };
+  struct Summary
+  {
+    Stat s[kStages];
+    uint64_t dropped{0}; // records lost to full rings (cumulative)
+  };
+
+  LatencyTrace();
+  ~LatencyTrace();
+  LatencyTrace(const LatencyTrace &) = delete;
+  LatencyTrace &operator=(const LatencyTrace &) = delete;
+
+  // register a producer; allocates, so call before the thread goes RT.
+  // nullptr when all kMaxWriters are taken
+  Writer *writer(const char *name);
+
+  // --- housekeeping ---
+  // keep up to 'max_records' drained records for writeChromeTrace (0: none)
+  void setExport(std::size_t max_records);
+  // move everything recorded so far into the current window / export buffer
+  void drain();
+  // drain, then take the window's distributions and start a new one
+  void snapshot_reset(Summary &out);
+  // Chrome trace event JSON of the exported records; false on I/O error
+  bool writeChromeTrace(const std::string &path);
+
+  static const char *stageName(Stage s);
+
+private:
+  std::atomic<Writer *> writers_[kMaxWriters]{};
+  std::atomic<std::size_t> n_writers_{0};
+  std::vector<std::unique_ptr<Writer>> owned_; // guarded by reg_m_
+  std::mutex reg_m_;
+
+  std::vector<int64_t> window_[kStages];
+  std::size_t export_max_{0};
+  std::vector<Record> export_;
+  std::mutex m_; // drain / snapshot / export may come from different threads
+};
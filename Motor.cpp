@@ -3,13 +3,15 @@
 #include <algorithm>
 
 Motor::Motor(const char *chipPath, int enc_a_line, int enc_b_line,
-             Motoron &driver, uint8_t motorId, unsigned enc_debounce_us)
-    : encoder_(chipPath, enc_a_line, enc_b_line, enc_debounce_us),
+             Motoron &driver, uint8_t motorId, unsigned enc_debounce_us,
+             EncoderSlot *enc_slot)
+    : encoder_(chipPath, enc_a_line, enc_b_line, enc_debounce_us, enc_slot),
       driver_(driver),
       motorId_(motorId),
       pid_(),
       counts_per_rev_(4096.0),
       gear_(1.0),
+      rev_per_count_(1.0 / 4096.0),
       last_counts_(0),
       pos_rev_(0.0),
       ref_pos_(0.0),
@@ -20,37 +22,61 @@ Motor::Motor(const char *chipPath, int enc_a_line, int enc_b_line,
   last_counts_ = encoder_.count();
 }
 
-void Motor::setCountsPerRev(double cpr4x) { counts_per_rev_ = cpr4x; }
-void Motor::setGear(double gear) { gear_ = gear; }
-void Motor::setPID(double kp, double ki, double kd) { pid_.setGains(kp, ki, kd); }
-void Motor::enable(bool en)
+void Motor::setCountsPerRev(double cpr4x)
+{
+  counts_per_rev_ = cpr4x;
+  rev_per_count_ = 1.0 / (counts_per_rev_ * gear_);
+}
+void Motor::setGear(double gear)
 {
-  enabled_ = en;
-  if (!en)
-    driver_.coastAll();
+  gear_ = gear;
+  rev_per_count_ = 1.0 / (counts_per_rev_ * gear_);
 }
-bool Motor::isEnabled() const { return enabled_; }
-void Motor::setReference(double rev) { ref_pos_ = rev; }
+void Motor::setRevPerCount(double rev_per_count) { rev_per_count_ = rev_per_count; }
+void Motor::setPID(double kp, double ki, double kd) { pid_.setGains(kp, ki, kd); }
+void Motor::enable(bool en) { enabled_.store(en, std::memory_order_relaxed); }
+bool Motor::isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+void Motor::setReference(double rev) { ref_pos_.store(rev, std::memory_order_relaxed); }
+double Motor::reference() const { return ref_pos_.load(std::memory_order_relaxed); }
 double Motor::position() const { return pos_rev_; }
 double Motor::command() const { return last_cmd_; }
 uint32_t Motor::encoderIllegal() const { return encoder_.illegal(); }
 
 void Motor::update(double dt_s)
 {
-  const int32_t c = encoder_.count();
+  compute(dt_s);
+  commit();
+}
+
+void Motor::compute(double dt_s)
+{
+  sample();
+  step(dt_s);
+}
+
+void Motor::sample() { sample(encoder_.count()); }
+
+void Motor::sample(int32_t c)
+{
   const int32_t dc = c - last_counts_;
   last_counts_ = c;
 
-  pos_rev_ += static_cast<double>(dc) / counts_per_rev_ / gear_;
+  pos_rev_ += static_cast<double>(dc) * rev_per_count_;
+}
 
-  const double u = pid_.step(ref_pos_, pos_rev_, dt_s);
+void Motor::step(double dt_s)
+{
+  const double u = pid_.step(ref_pos_.load(std::memory_order_relaxed), pos_rev_, dt_s);
 
   int16_t speed = static_cast<int16_t>(
       std::max(-800.0, std::min(800.0, u * u_to_speed_)));
   last_cmd_ = speed;
+}
 
-  if (enabled_)
-    driver_.setSpeed(motorId_, speed);
-  else
-    driver_.coastAll();
+bool Motor::commit(int64_t bus_deadline_ns)
+{
+  const int16_t speed = static_cast<int16_t>(last_cmd_);
+  if (enabled_.load(std::memory_order_relaxed))
+    return driver_.trySetSpeed(motorId_, speed, bus_deadline_ns);
+  return driver_.tryCoastAll(bus_deadline_ns);
 }
\ No newline at end of file
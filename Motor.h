@@ -3,6 +3,7 @@
 #include "PID.h"
 #include "Encoder.h"
 #include "Motoron.h"
+#include <atomic>
 #include <cstdint>
 
 class Motor
@@ -12,21 +13,40 @@ public:
   // encoder lines are passed here; Motor constructs its Encoder
   Motor(const char *chipPath, int enc_a_line, int enc_b_line,
         Motoron &driver, uint8_t motorId,
-        unsigned enc_debounce_us = 5);
+        unsigned enc_debounce_us = 5,
+        EncoderSlot *enc_slot = nullptr);
 
   void setCountsPerRev(double cpr4x);
   void setGear(double gear);
+  // output revs per 4x count; normally derived from CPR and gear, Robot
+  // passes a compile-time constant so update() needs no division
+  void setRevPerCount(double rev_per_count);
   void setPID(double kp, double ki, double kd);
+  // any thread; takes effect at the next commit() (disabled: coast)
   void enable(bool en);
   bool isEnabled() const;
 
-  void setReference(double rev);
+  void setReference(double rev); // any thread
+  double reference() const;
   double position() const;
   double command() const;
   uint32_t encoderIllegal() const;
+  Encoder &encoder() { return encoder_; }
 
-  // called at 1 kHz
+  // called at 1 kHz: compute() then commit()
   void update(double dt_s);
+  // read encoder and run PID; no bus traffic (= sample() + step())
+  void compute(double dt_s);
+  // read encoder, update position
+  void sample();
+  // update position from a count taken elsewhere (EncoderBank::snapshotAll)
+  void sample(int32_t counts);
+  // PID on the current position
+  void step(double dt_s);
+  // send the last computed command to the driver; retries until
+  // bus_deadline_ns (CLOCK_MONOTONIC, 0: one attempt), never throws.
+  // false if the write did not reach the board
+  bool commit(int64_t bus_deadline_ns = 0);
 
 private:
   Encoder encoder_;
@@ -36,12 +56,13 @@ private:
   PID pid_;
   double counts_per_rev_;
   double gear_;
+  double rev_per_count_;
 
   int32_t last_counts_;
   double pos_rev_;
-  double ref_pos_;
+  std::atomic<double> ref_pos_;
   double last_cmd_;
-  bool enabled_;
+  std::atomic<bool> enabled_;
 
   double u_to_speed_;
 };
\ No newline at end of file
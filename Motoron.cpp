@@ -1,69 +1,268 @@
 // Motoron.cpp
 #include "Motoron.h"
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <stdexcept>
-#include <cstring>
+#include <time.h>
 #include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+
+namespace mp = motoron_protocol;
 
 Motoron::Motoron(const std::string &dev, uint8_t addr)
-    : fd_(-1), address_(addr), enabled_(false) { openBus(dev); }
+    : transport_(new I2CTransport(dev, addr)), enabled_(false) {}
 
-Motoron::~Motoron()
+Motoron::Motoron(std::unique_ptr<MotoronTransport> transport)
+    : transport_(std::move(transport)), enabled_(false)
 {
-  if (fd_ >= 0)
-    ::close(fd_);
+  if (!transport_)
+    throw std::invalid_argument("Motoron: null transport");
 }
 
-void Motoron::openBus(const std::string &dev)
-{
-  fd_ = ::open(dev.c_str(), O_RDWR);
-  if (fd_ < 0)
-    throw std::runtime_error(std::string("open ") + dev + ": " + std::strerror(errno));
-  if (ioctl(fd_, I2C_SLAVE, address_) < 0)
-    throw std::runtime_error(std::string("I2C_SLAVE: ") + std::strerror(errno));
-}
+Motoron::~Motoron() = default;
+
 void Motoron::writeBytes(const uint8_t *data, size_t n)
 {
-  if (::write(fd_, data, n) != (ssize_t)n)
-    throw std::runtime_error(std::string("i2c write: ") + std::strerror(errno));
+  transport_->write(data, n);
 }
 void Motoron::initBasic()
 {
-  const uint8_t disable_crc[] = {CMD_SET_PROTOCOL_OPTIONS, 0x04};
-  writeBytes(disable_crc, sizeof(disable_crc));
-  
-  const uint8_t clear_reset[] = {CMD_CLEAR_LATCHED_STATUS_FLAGS, 0x00, 0x04};
-  writeBytes(clear_reset, sizeof(clear_reset));
+  // set_protocol_options always carries a CRC byte, so it works whether or
+  // not the board currently expects CRC (e.g. right after reset)
+  uint8_t f[mp::kMaxFrame];
+  uint8_t options = 1 << PROTOCOL_OPTION_I2C_GENERAL_CALL;
+  if (crc_)
+    options |= (1 << PROTOCOL_OPTION_CRC_FOR_COMMANDS) | (1 << PROTOCOL_OPTION_CRC_FOR_RESPONSES);
+  writeBytes(f, mp::setProtocolOptions(f, options));
+  writeBytes(f, mp::clearLatchedStatusFlags(f, 1 << STATUS_FLAG_RESET, crc_));
   enabled_ = true;
 }
+
 void Motoron::setSpeed(uint8_t motor, int16_t speed)
 {
   if (!enabled_)
     return;
-  speed = std::max<int16_t>(-800, std::min<int16_t>(800, speed));
-  uint8_t cmd[4];
-  cmd[0] = CMD_SET_SPEED_NOW;
-  cmd[1] = motor & 0x7F;
-  cmd[2] = speed & 0x7F;
-  cmd[3] = (speed >> 7) & 0x7F;
-  writeBytes(cmd, sizeof(cmd));
+  uint8_t cmd[mp::kMaxFrame];
+  writeBytes(cmd, mp::setSpeedNow(cmd, motor, speed, crc_));
 }
 
 void Motoron::coastAll()
 {
-  uint8_t cmd[8];
-  cmd[0] = 0xE2;
-  for (int i = 1; i < 8; ++i)
-    cmd[i] = 0;
-  writeBytes(cmd, sizeof(cmd));
+  uint8_t cmd[mp::kMaxFrame];
+  writeBytes(cmd, mp::setAllSpeedsNow(cmd, 0, 0, 0, crc_));
 }
 void Motoron::enable(bool en)
 {
   enabled_ = en;
   if (!en)
-    coastAll();
+    tryCoastAll();
+}
+bool Motoron::isEnabled() const { return enabled_; }
+
+// ---- control thread ----
+
+int64_t Motoron::nowNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+bool Motoron::send_(const uint8_t *data, size_t n, int64_t deadline_ns)
+{
+  if (health_.load(std::memory_order_acquire) == Health::Recovering)
+  {
+    c_.skipped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  c_.writes.fetch_add(1, std::memory_order_relaxed);
+  int err = transport_->tryWrite(data, n);
+  while (err)
+  {
+    // a NACKing board needs time, not back-to-back attempts; spin rather
+    // than sleep, this runs inside the SCHED_FIFO tick
+    const int64_t t = nowNs();
+    if (t >= deadline_ns)
+      break;
+    const int64_t until = std::min(t + kRetryGapNs, deadline_ns);
+    while (nowNs() < until)
+    {
+    }
+    if (until == deadline_ns)
+      break;
+    c_.retries.fetch_add(1, std::memory_order_relaxed);
+    err = transport_->tryWrite(data, n);
+  }
+  if (err)
+  {
+    fail_(err);
+    return false;
+  }
+  consecutive_ = 0;
+  if (health_.load(std::memory_order_relaxed) == Health::Failing)
+    health_.store(Health::Ok, std::memory_order_relaxed);
+  return true;
+}
+
+void Motoron::fail_(int err)
+{
+  c_.failed.fetch_add(1, std::memory_order_relaxed);
+  c_.last_errno.store(err, std::memory_order_relaxed);
+  if (++consecutive_ >= fail_limit_)
+    handOver_(true);
+  else
+    health_.store(Health::Failing, std::memory_order_relaxed);
+}
+
+// From here on the recovery thread owns the transport and our state
+void Motoron::handOver_(bool bus_fault)
+{
+  bus_fault_ = bus_fault;
+  c_.handovers.fetch_add(1, std::memory_order_relaxed);
+  health_.store(Health::Recovering, std::memory_order_release);
+}
+
+bool Motoron::trySetSpeed(uint8_t motor, int16_t speed, int64_t deadline_ns)
+{
+  if (!enabled_.load(std::memory_order_relaxed))
+    return false;
+  uint8_t cmd[mp::kMaxFrame];
+  return send_(cmd, mp::setSpeedNow(cmd, motor, speed, crc_), deadline_ns);
+}
+
+bool Motoron::tryCoastAll(int64_t deadline_ns)
+{
+  uint8_t cmd[mp::kMaxFrame];
+  return send_(cmd, mp::setAllSpeedsNow(cmd, 0, 0, 0, crc_), deadline_ns);
+}
+
+bool Motoron::requestStatus(int64_t deadline_ns)
+{
+  if (status_pending_)
+    return true;
+  uint8_t cmd[mp::kMaxFrame];
+  status_pending_ = send_(cmd, mp::getVariables(cmd, 0, 1, 2, crc_), deadline_ns); // status flags (u16)
+  return status_pending_;
+}
+
+bool Motoron::collectStatus()
+{
+  if (health_.load(std::memory_order_acquire) == Health::Recovering || !status_pending_)
+    return false;
+  status_pending_ = false;
+  // no retries: a second read would not return the same response
+  // Commands are ACKed even when the board rejects them (e.g. a bad CRC),
+  // so unanswered or corrupted polls count on their own
+  uint8_t r[mp::kMaxFrame];
+  if (int err = transport_->tryRead(r, mp::responseSize(2, crc_)))
+    return pollFailed_(err);
+  if (!mp::checkResponse(r, 2, crc_))
+  {
+    c_.crc_errors.fetch_add(1, std::memory_order_relaxed);
+    return pollFailed_(EBADMSG);
+  }
+  poll_fails_ = 0;
+  const uint16_t flags = r[0] | (r[1] << 8);
+  status_.store(flags, std::memory_order_relaxed);
+  c_.polls.fetch_add(1, std::memory_order_relaxed);
+  if (flags & (1 << STATUS_FLAG_RESET))
+  {
+    // board restarted (brown-out, watchdog): back to default options, outputs off
+    c_.resets.fetch_add(1, std::memory_order_relaxed);
+    handOver_(false);
+  }
+  else if (flags & (1 << STATUS_FLAG_CRC_ERROR))
+  {
+    // the board dropped a command with a bad CRC since the last clear;
+    // clear the latched flag so the next poll sees only new ones
+    c_.board_crc_errors.fetch_add(1, std::memory_order_relaxed);
+    uint8_t cmd[mp::kMaxFrame];
+    send_(cmd, mp::clearLatchedStatusFlags(cmd, 1 << STATUS_FLAG_CRC_ERROR, crc_), 0);
+  }
+  return true;
+}
+
+bool Motoron::pollFailed_(int err)
+{
+  c_.failed.fetch_add(1, std::memory_order_relaxed);
+  c_.last_errno.store(err, std::memory_order_relaxed);
+  if (++poll_fails_ >= 2)
+    handOver_(true);
+  else
+    health_.store(Health::Failing, std::memory_order_relaxed);
+  return false;
+}
+
+// ---- recovery thread ----
+
+bool Motoron::recover()
+{
+  if (health_.load(std::memory_order_acquire) != Health::Recovering)
+    return true;
+  if (bus_fault_)
+  {
+    if (int err = transport_->reopen())
+    {
+      c_.last_errno.store(err, std::memory_order_relaxed);
+      return false;
+    }
+    c_.reopens.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // initBasic() sends set_protocol_options with a CRC, so it is accepted
+  // whether the board kept our options or came back from a reset
+  const bool was_enabled = enabled_.load(std::memory_order_relaxed);
+  uint8_t r[mp::kMaxFrame];
+  try
+  {
+    initBasic();
+    enabled_.store(was_enabled, std::memory_order_relaxed);
+    uint8_t cmd[mp::kMaxFrame];
+    transport_->write(cmd, mp::getVariables(cmd, 0, 1, 2, crc_));
+    // give the board time to prepare the response (see motoron.py)
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    transport_->read(r, mp::responseSize(2, crc_));
+  }
+  catch (const std::runtime_error &)
+  {
+    enabled_.store(was_enabled, std::memory_order_relaxed);
+    bus_fault_ = true;
+    return false;
+  }
+  if (!mp::checkResponse(r, 2, crc_))
+  {
+    c_.crc_errors.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  const uint16_t flags = r[0] | (r[1] << 8);
+  status_.store(flags, std::memory_order_relaxed);
+  if (flags & (1 << STATUS_FLAG_RESET))
+    return false;
+
+  consecutive_ = 0;
+  poll_fails_ = 0;
+  status_pending_ = false;
+  bus_fault_ = false;
+  c_.reinits.fetch_add(1, std::memory_order_relaxed);
+  health_.store(Health::Ok, std::memory_order_release);
+  return true;
+}
+
+Motoron::BusStats Motoron::busStats() const
+{
+  BusStats s;
+  s.writes = c_.writes.load(std::memory_order_relaxed);
+  s.retries = c_.retries.load(std::memory_order_relaxed);
+  s.failed = c_.failed.load(std::memory_order_relaxed);
+  s.skipped = c_.skipped.load(std::memory_order_relaxed);
+  s.polls = c_.polls.load(std::memory_order_relaxed);
+  s.resets = c_.resets.load(std::memory_order_relaxed);
+  s.handovers = c_.handovers.load(std::memory_order_relaxed);
+  s.reopens = c_.reopens.load(std::memory_order_relaxed);
+  s.reinits = c_.reinits.load(std::memory_order_relaxed);
+  s.crc_errors = c_.crc_errors.load(std::memory_order_relaxed);
+  s.board_crc_errors = c_.board_crc_errors.load(std::memory_order_relaxed);
+  s.last_errno = c_.last_errno.load(std::memory_order_relaxed);
+  s.health = health();
+  return s;
 }
-bool Motoron::isEnabled() const { return enabled_; }
\ No newline at end of file
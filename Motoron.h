@@ -1,5 +1,10 @@
 #pragma once
+#include "MotoronTransport.h"
+#include "MotoronProtocol.h"
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 #define CMD_GET_FIRMWARE_VERSION 0x87
@@ -28,23 +33,115 @@
 #define CMD_MULTI_DEVICE_ERROR_CHECK 0xF9
 #define CMD_MULTI_DEVICE_WRITE 0xFA
 
+#define PROTOCOL_OPTION_CRC_FOR_COMMANDS 0
+#define PROTOCOL_OPTION_CRC_FOR_RESPONSES 1
+#define PROTOCOL_OPTION_I2C_GENERAL_CALL 2
+
+#define STATUS_FLAG_PROTOCOL_ERROR 0
+#define STATUS_FLAG_CRC_ERROR 1
+#define STATUS_FLAG_COMMAND_TIMEOUT_LATCHED 2
+#define STATUS_FLAG_RESET 9
+#define STATUS_FLAG_COMMAND_TIMEOUT 10
+#define STATUS_FLAG_ERROR_ACTIVE 13
+#define STATUS_FLAG_MOTOR_OUTPUT_ENABLED 14
+#define STATUS_FLAG_MOTOR_DRIVING 15
+
 class Motoron
 {
 public:
   explicit Motoron(const std::string &i2cDev = "/dev/i2c-1", uint8_t addr = 0x10);
+  // any transport, e.g. FdTransport (serial) or an emulator
+  explicit Motoron(std::unique_ptr<MotoronTransport> transport);
   ~Motoron();
 
-  void initBasic();                            // disable CRC, clear reset flag; enables outputs
+  // 7-bit CRC used by the Motoron for commands and responses (table driven,
+  // see MotoronProtocol.h)
+  static uint8_t crc(const uint8_t *data, size_t n) { return motoron_protocol::crc(data, n); }
+  static int64_t nowNs(); // CLOCK_MONOTONIC
+
+  // CRC on commands and responses (default on); applied by initBasic()
+  void setCrc(bool on) { crc_ = on; }
+  bool crcEnabled() const { return crc_; }
+
+  void initBasic();                            // set CRC options, clear reset flag; enables outputs
   void setSpeed(uint8_t motor, int16_t speed); // [-800..800]
   void coastAll();
   void enable(bool en);
   bool isEnabled() const;
 
+  // --- control thread: never throws ---
+  //
+  // Every write gets one attempt, then retries until deadline_ns (0: none),
+  // so a tick's retries are bounded in time, not count. Retries are spaced
+  // by a short busy-wait (no sleep inside the RT tick). After fail_limit
+  // consecutive failed writes, two unanswered status reads, or a set reset
+  // flag, the board goes to Recovering: calls here are skipped (other
+  // boards carry on) and BusSupervisor reopens and re-initialises it off
+  // the control thread.
+  static constexpr int64_t kRetryGapNs = 20000; // between retries, capped at the deadline
+  enum class Health : uint8_t
+  {
+    Ok,
+    Failing,   // last write missed its budget
+    Recovering // owned by the recovery thread
+  };
+  struct BusStats
+  {
+    uint64_t writes{0};     // control-path writes attempted
+    uint64_t retries{0};    // extra attempts within budget
+    uint64_t failed{0};     // writes/reads that ran out of budget
+    uint64_t skipped{0};    // calls dropped while Recovering
+    uint64_t polls{0};      // status reads completed
+    uint64_t resets{0};     // reset flag seen
+    uint64_t handovers{0};  // Ok/Failing -> Recovering
+    uint64_t reopens{0};    // transport reopened
+    uint64_t reinits{0};    // successful recoveries (initBasic)
+    uint64_t crc_errors{0};       // responses that failed the CRC check
+    uint64_t board_crc_errors{0}; // CRC error flag raised by the board (bad commands seen)
+    int last_errno{0};
+    Health health{Health::Ok};
+  };
+
+  bool trySetSpeed(uint8_t motor, int16_t speed, int64_t deadline_ns = 0);
+  bool tryCoastAll(int64_t deadline_ns = 0);
+  // Split-phase status read: request on one tick, collect on a later one,
+  // so the control thread never waits for the board to prepare a response
+  // (no other command may go to this board in between).
+  bool requestStatus(int64_t deadline_ns = 0);
+  bool collectStatus();
+  bool statusPending() const { return status_pending_; }
+  uint16_t lastStatus() const { return status_.load(std::memory_order_relaxed); }
+  void setFailLimit(uint32_t n) { fail_limit_ = n ? n : 1; }
+  Health health() const { return health_.load(std::memory_order_acquire); }
+  BusStats busStats() const;
+
+  // --- recovery thread, only while health() == Recovering ---
+  // reopen after bus faults, re-init, confirm; true once back to Ok
+  bool recover();
+
 private:
-  int fd_;
-  uint8_t address_;
-  bool enabled_;
+  std::unique_ptr<MotoronTransport> transport_;
+  std::atomic<bool> enabled_;
+  bool crc_ = true;
+
+  std::atomic<Health> health_{Health::Ok};
+  bool bus_fault_ = false; // Recovering because of failed writes (needs reopen)
+  uint32_t consecutive_ = 0; // failed writes in a row
+  uint32_t poll_fails_ = 0;  // unanswered status reads in a row
+  uint32_t fail_limit_ = 8;
+  bool status_pending_ = false;
+  std::atomic<uint16_t> status_{0};
+  struct
+  {
+    std::atomic<uint64_t> writes{0}, retries{0}, failed{0}, skipped{0}, polls{0};
+    std::atomic<uint64_t> resets{0}, handovers{0}, reopens{0}, reinits{0};
+    std::atomic<uint64_t> crc_errors{0}, board_crc_errors{0};
+    std::atomic<int> last_errno{0};
+  } c_;
 
-  void openBus(const std::string &dev);
   void writeBytes(const uint8_t *data, size_t n);
-};
\ No newline at end of file
+  bool send_(const uint8_t *data, size_t n, int64_t deadline_ns);
+  void fail_(int err);
+  void handOver_(bool bus_fault);
+  bool pollFailed_(int err);
+};
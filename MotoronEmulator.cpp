@@ -0,0 +1,734 @@
+// MotoronEmulator.cpp
+#include "MotoronEmulator.h"
+#include "Motoron.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static constexpr uint8_t ERROR_CHECK_CONTINUE = 0x3C;
+static constexpr uint8_t ERROR_CHECK_DONE = 0x00;
+static constexpr uint16_t LATCHED_STATUS_FLAGS = 0x03FF;
+static constexpr uint16_t MAX_ERROR_MASK = 0x07FF;
+static constexpr uint16_t MAX_COMMAND_TIMEOUT = 16250;
+static constexpr uint16_t MAX_ACCEL = 6400;
+static constexpr int16_t MAX_SPEED = 800;
+static constexpr double kUpdatePeriod = 0.010; // accel/decel step
+
+MotoronEmulator::MotoronEmulator(Bus bus, uint16_t device_number)
+    : bus_(bus), device_(device_number)
+{
+  std::memset(eeprom_, 0xFF, sizeof(eeprom_));
+  eeprom_[1] = device_number & 0x7F;
+  defaults_();
+}
+
+void MotoronEmulator::defaults_()
+{
+  options_ = (1 << PROTOCOL_OPTION_CRC_FOR_COMMANDS) |
+             (1 << PROTOCOL_OPTION_CRC_FOR_RESPONSES) |
+             (1 << PROTOCOL_OPTION_I2C_GENERAL_CALL);
+  flags_ = 1 << STATUS_FLAG_RESET;
+  timeout_ = 375; // 1500 ms
+  error_response_ = 0;
+  error_mask_ = (1 << STATUS_FLAG_COMMAND_TIMEOUT) | (1 << STATUS_FLAG_RESET);
+  for (auto &m : mv_)
+    m = MotorVars{};
+  since_cmd_s_ = 0.0;
+  accel_acc_s_ = 0.0;
+}
+
+void MotoronEmulator::powerCycle()
+{
+  std::lock_guard<std::mutex> lk(m_);
+  defaults_();
+  frame_.clear();
+  cmd_ = 0;
+  pololu_ = false;
+  optional_crc_ = false;
+  skip_ = false;
+  tx_.clear();
+}
+
+// ---- status ----
+
+uint16_t MotoronEmulator::flags_now_() const
+{
+  uint16_t f = flags_;
+  if (f & error_mask_)
+    f |= 1 << STATUS_FLAG_ERROR_ACTIVE;
+  else
+    f |= 1 << STATUS_FLAG_MOTOR_OUTPUT_ENABLED;
+  for (const auto &m : mv_)
+    if (m.current != 0)
+      f |= 1 << STATUS_FLAG_MOTOR_DRIVING;
+  return f;
+}
+
+bool MotoronEmulator::errorActive_() const { return (flags_ & error_mask_) != 0; }
+
+void MotoronEmulator::kickTimeout_()
+{
+  since_cmd_s_ = 0.0;
+  flags_ &= ~(1 << STATUS_FLAG_COMMAND_TIMEOUT);
+}
+
+// ---- framing ----
+
+// Data bytes after the command byte; SIZE_MAX = unknown command.
+// Multi-device write needs its first 3 data bytes to know its length.
+size_t MotoronEmulator::dataLength_(uint8_t cmd, const uint8_t *partial, size_t have) const
+{
+  switch (cmd)
+  {
+  case CMD_GET_FIRMWARE_VERSION:
+  case CMD_REINITIALIZE:
+  case CMD_RESET:
+  case CMD_COAST_NOW:
+  case CMD_SET_ALL_SPEEDS_USING_BUFFERS:
+  case CMD_SET_ALL_SPEEDS_NOW_USING_BUFFERS:
+  case CMD_RESET_COMMAND_TIMEOUT:
+    return 0;
+  case CMD_CLEAR_MOTOR_FAULT:
+    return 1;
+  case CMD_SET_PROTOCOL_OPTIONS:
+  case CMD_READ_EEPROM:
+  case CMD_CLEAR_LATCHED_STATUS_FLAGS:
+  case CMD_SET_LATCHED_STATUS_FLAGS:
+    return 2;
+  case CMD_GET_VARIABLES:
+  case CMD_SET_BRAKING:
+  case CMD_SET_BRAKING_NOW:
+  case CMD_SET_SPEED:
+  case CMD_SET_SPEED_NOW:
+  case CMD_SET_BUFFERED_SPEED:
+    return 3;
+  case CMD_SET_VARIABLE:
+    return 4;
+  case CMD_WRITE_EEPROM:
+  case CMD_SET_ALL_SPEEDS:
+  case CMD_SET_ALL_SPEEDS_NOW:
+  case CMD_SET_ALL_BUFFERED_SPEEDS:
+    return 2 * kMotors;
+  case CMD_MULTI_DEVICE_ERROR_CHECK:
+    return bus_ == Bus::Serial ? 2 : SIZE_MAX;
+  case CMD_MULTI_DEVICE_WRITE:
+    if (bus_ != Bus::Serial)
+      return SIZE_MAX;
+    if (have < 3)
+      return 3; // provisional
+    return 4 + (size_t)partial[1] * partial[2];
+  default:
+    return SIZE_MAX;
+  }
+}
+
+void MotoronEmulator::protocolError_()
+{
+  c_.protocol_errors++;
+  flags_ |= 1 << STATUS_FLAG_PROTOCOL_ERROR;
+  frame_.clear();
+  cmd_ = 0;
+  pololu_ = false;
+  optional_crc_ = false;
+  skip_ = true;
+}
+
+void MotoronEmulator::startCommand_(uint8_t cmd)
+{
+  need_ = dataLength_(cmd, nullptr, 0);
+  if (need_ == SIZE_MAX)
+  {
+    protocolError_();
+    return;
+  }
+  cmd_ = cmd;
+}
+
+void MotoronEmulator::receive(const uint8_t *data, size_t n)
+{
+  std::lock_guard<std::mutex> lk(m_);
+  for (size_t i = 0; i < n; ++i)
+    byte_(data[i]);
+}
+
+void MotoronEmulator::byte_(uint8_t b)
+{
+  c_.bytes++;
+
+  // set_protocol_options/reinitialize/reset take an optional CRC byte:
+  // a data byte here is that CRC, a command byte means there was none
+  if (optional_crc_)
+  {
+    optional_crc_ = false;
+    if (!(b & 0x80))
+    {
+      frame_.push_back(b);
+      finishFrame_(true);
+      return;
+    }
+    finishFrame_(false);
+  }
+
+  if (b & 0x80)
+  {
+    if (cmd_ || pololu_)
+      protocolError_(); // previous frame cut short
+    skip_ = false;
+    frame_.clear();
+    frame_.push_back(b);
+    hdr_ = 0;
+    addressed_ = true;
+    if (b == 0xAA && bus_ == Bus::Serial)
+    {
+      pololu_ = true;
+      return;
+    }
+    startCommand_(b);
+  }
+  else if (pololu_ && !cmd_)
+  {
+    frame_.push_back(b);
+    if (frame_.size() == 2)
+    {
+      addressed_ = b == (device_ & 0x7F);
+      return;
+    }
+    hdr_ = 2;
+    startCommand_(b | 0x80);
+  }
+  else if (!cmd_)
+  {
+    if (!skip_)
+      protocolError_(); // stray data byte
+    return;
+  }
+  else
+  {
+    frame_.push_back(b);
+  }
+  if (!cmd_)
+    return;
+
+  const size_t have = frame_.size() - hdr_ - 1;
+  if (cmd_ == CMD_MULTI_DEVICE_WRITE)
+    need_ = dataLength_(cmd_, frame_.data() + hdr_ + 1, have);
+  const bool crc_on = options_ & (1 << PROTOCOL_OPTION_CRC_FOR_COMMANDS);
+  if (have == need_ + 1)
+    finishFrame_(true);
+  else if (have == need_ && !crc_on)
+  {
+    if (cmd_ == CMD_SET_PROTOCOL_OPTIONS || cmd_ == CMD_REINITIALIZE || cmd_ == CMD_RESET)
+      optional_crc_ = true;
+    else
+      finishFrame_(false);
+  }
+}
+
+void MotoronEmulator::endTransaction()
+{
+  std::lock_guard<std::mutex> lk(m_);
+  if (optional_crc_)
+  {
+    optional_crc_ = false;
+    finishFrame_(false);
+  }
+  else if (bus_ == Bus::I2C && (cmd_ || pololu_))
+    protocolError_(); // transaction ended mid-frame
+  if (bus_ == Bus::I2C)
+    skip_ = false;
+}
+
+void MotoronEmulator::finishFrame_(bool with_crc)
+{
+  const size_t body = frame_.size() - (with_crc ? 1 : 0);
+  if (with_crc && Motoron::crc(frame_.data(), body) != frame_.back())
+  {
+    c_.crc_errors++;
+    flags_ |= 1 << STATUS_FLAG_CRC_ERROR;
+  }
+  else if (addressed_)
+  {
+    execute_(cmd_, frame_.data() + hdr_ + 1, need_);
+  }
+  frame_.clear();
+  cmd_ = 0;
+  pololu_ = false;
+}
+
+void MotoronEmulator::reply_(const uint8_t *d, size_t n)
+{
+  tx_.insert(tx_.end(), d, d + n);
+  if (options_ & (1 << PROTOCOL_OPTION_CRC_FOR_RESPONSES))
+    tx_.push_back(Motoron::crc(d, n));
+  c_.responses++;
+}
+
+size_t MotoronEmulator::respond(uint8_t *out, size_t max)
+{
+  std::lock_guard<std::mutex> lk(m_);
+  size_t n = std::min(max, tx_.size());
+  std::copy(tx_.begin(), tx_.begin() + n, out);
+  tx_.erase(tx_.begin(), tx_.begin() + n);
+  return n;
+}
+
+size_t MotoronEmulator::pendingResponse() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return tx_.size();
+}
+
+// ---- commands ----
+
+static int16_t speed14(uint8_t lo, uint8_t hi)
+{
+  int v = lo | (hi << 7);
+  if (v & 0x2000)
+    v -= 0x4000;
+  return (int16_t)std::max<int>(-MAX_SPEED, std::min<int>(MAX_SPEED, v));
+}
+
+// which: 0 = target, 1 = target and current now, 2 = buffered
+bool MotoronEmulator::setSpeed_(uint8_t motor, int16_t v, int which)
+{
+  if (motor < 1 || motor > kMotors)
+    return false;
+  MotorVars &m = mv_[motor - 1];
+  if (which == 2)
+    m.buffered = v;
+  else
+  {
+    m.target = v;
+    m.brake = 0;
+    if (which == 1)
+      m.current = v;
+  }
+  return true;
+}
+
+bool MotoronEmulator::setVar_(uint8_t motor, uint8_t off, uint16_t v)
+{
+  if (motor == 0)
+  {
+    switch (off)
+    {
+    case 5: timeout_ = std::min(v, MAX_COMMAND_TIMEOUT); return true;
+    case 7: error_response_ = v & 3; return true;
+    case 8: error_mask_ = v & MAX_ERROR_MASK; return true;
+    default: return false;
+    }
+  }
+  if (motor > kMotors)
+    return false;
+  MotorVars &m = mv_[motor - 1];
+  switch (off)
+  {
+  case 1: m.pwm_mode = v & 0xFF; return true;
+  case 10: m.accel_fwd = std::min(v, MAX_ACCEL); return true;
+  case 12: m.accel_rev = std::min(v, MAX_ACCEL); return true;
+  case 14: m.decel_fwd = std::min(v, MAX_ACCEL); return true;
+  case 16: m.decel_rev = std::min(v, MAX_ACCEL); return true;
+  case 18: m.start_fwd = std::min<uint16_t>(v, MAX_SPEED); return true;
+  case 20: m.start_rev = std::min<uint16_t>(v, MAX_SPEED); return true;
+  case 22: m.dir_delay_fwd = std::min<uint16_t>(v, 250); return true;
+  case 23: m.dir_delay_rev = std::min<uint16_t>(v, 250); return true;
+  case 26: m.current_limit = v; return true;
+  case 34: m.cs_offset = v & 0xFF; return true;
+  case 35: m.cs_min_divisor = v & 0xFF; return true;
+  default: return false;
+  }
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+void MotoronEmulator::readVars_(uint8_t motor, uint8_t off, uint8_t len)
+{
+  uint8_t img[40] = {};
+  if (motor == 0)
+  {
+    img[0] = options_;
+    put16(img + 1, flags_now_());
+    // 3: VIN (not modelled)
+    put16(img + 5, timeout_);
+    img[7] = error_response_;
+    put16(img + 8, error_mask_);
+    img[10] = 0x01; // JMP1 open
+  }
+  else
+  {
+    const MotorVars &m = mv_[motor - 1];
+    img[1] = m.pwm_mode;
+    put16(img + 2, (uint16_t)m.target);
+    put16(img + 4, (uint16_t)m.brake);
+    put16(img + 6, (uint16_t)m.current);
+    put16(img + 8, (uint16_t)m.buffered);
+    put16(img + 10, m.accel_fwd);
+    put16(img + 12, m.accel_rev);
+    put16(img + 14, m.decel_fwd);
+    put16(img + 16, m.decel_rev);
+    put16(img + 18, m.start_fwd);
+    put16(img + 20, m.start_rev);
+    img[22] = m.dir_delay_fwd;
+    img[23] = m.dir_delay_rev;
+    put16(img + 26, m.current_limit);
+    img[34] = m.cs_offset;
+    img[35] = m.cs_min_divisor;
+  }
+  uint8_t out[128];
+  for (uint8_t i = 0; i < len; ++i)
+    out[i] = (size_t)off + i < sizeof(img) ? img[off + i] : 0;
+  reply_(out, len);
+}
+
+void MotoronEmulator::execute_(uint8_t cmd, const uint8_t *d, size_t n)
+{
+  c_.frames++;
+  bool ok = true;
+  switch (cmd)
+  {
+  case CMD_GET_FIRMWARE_VERSION:
+  {
+    const uint8_t r[4] = {kProductId & 0xFF, kProductId >> 8, 0x00, 0x01};
+    reply_(r, sizeof(r));
+    break;
+  }
+  case CMD_SET_PROTOCOL_OPTIONS:
+    if (d[1] != (~d[0] & 0x7F))
+      ok = false;
+    else
+      options_ = d[0] & 0x07;
+    break;
+  case CMD_READ_EEPROM:
+  {
+    uint8_t out[128];
+    for (uint8_t i = 0; i < d[1]; ++i)
+      out[i] = (size_t)d[0] + i < sizeof(eeprom_) ? eeprom_[d[0] + i] : 0xFF;
+    reply_(out, d[1]);
+    break;
+  }
+  case CMD_WRITE_EEPROM:
+    if (d[3] != (d[0] ^ 0x7F) || d[4] != (d[1] ^ 0x7F) || d[5] != (d[2] ^ 0x7F) ||
+        d[0] >= sizeof(eeprom_))
+      ok = false;
+    else
+      eeprom_[d[0]] = d[1] | (d[2] << 7);
+    break;
+  case CMD_REINITIALIZE:
+  case CMD_RESET:
+    defaults_();
+    if (cmd == CMD_RESET)
+      tx_.clear();
+    break;
+  case CMD_GET_VARIABLES:
+    if (d[0] > kMotors)
+      ok = false;
+    else
+      readVars_(d[0], d[1], d[2]);
+    break;
+  case CMD_SET_VARIABLE:
+    ok = setVar_(d[0], d[1], d[2] | (d[3] << 7));
+    break;
+  case CMD_COAST_NOW:
+    for (auto &m : mv_)
+      m.target = m.current = m.brake = 0;
+    kickTimeout_();
+    break;
+  case CMD_CLEAR_MOTOR_FAULT:
+    break; // motor faults not modelled
+  case CMD_CLEAR_LATCHED_STATUS_FLAGS:
+    flags_ &= ~((d[0] | (d[1] << 7)) & LATCHED_STATUS_FLAGS);
+    break;
+  case CMD_SET_LATCHED_STATUS_FLAGS:
+    flags_ |= (d[0] | (d[1] << 7)) & LATCHED_STATUS_FLAGS;
+    break;
+  case CMD_SET_BRAKING:
+  case CMD_SET_BRAKING_NOW:
+    if (d[0] < 1 || d[0] > kMotors)
+      ok = false;
+    else
+    {
+      MotorVars &m = mv_[d[0] - 1];
+      m.target = 0;
+      m.brake = std::min<uint16_t>(d[1] | (d[2] << 7), MAX_SPEED);
+      if (cmd == CMD_SET_BRAKING_NOW)
+        m.current = 0;
+      kickTimeout_();
+    }
+    break;
+  case CMD_SET_SPEED:
+  case CMD_SET_SPEED_NOW:
+  case CMD_SET_BUFFERED_SPEED:
+  {
+    const int which = cmd == CMD_SET_SPEED ? 0 : cmd == CMD_SET_SPEED_NOW ? 1 : 2;
+    ok = setSpeed_(d[0], speed14(d[1], d[2]), which);
+    if (ok && which != 2)
+      kickTimeout_();
+    break;
+  }
+  case CMD_SET_ALL_SPEEDS:
+  case CMD_SET_ALL_SPEEDS_NOW:
+  case CMD_SET_ALL_BUFFERED_SPEEDS:
+  {
+    const int which = cmd == CMD_SET_ALL_SPEEDS ? 0 : cmd == CMD_SET_ALL_SPEEDS_NOW ? 1 : 2;
+    for (int i = 0; i < kMotors; ++i)
+      setSpeed_(i + 1, speed14(d[2 * i], d[2 * i + 1]), which);
+    if (which != 2)
+      kickTimeout_();
+    break;
+  }
+  case CMD_SET_ALL_SPEEDS_USING_BUFFERS:
+  case CMD_SET_ALL_SPEEDS_NOW_USING_BUFFERS:
+    for (int i = 0; i < kMotors; ++i)
+      setSpeed_(i + 1, mv_[i].buffered, cmd == CMD_SET_ALL_SPEEDS_NOW_USING_BUFFERS);
+    kickTimeout_();
+    break;
+  case CMD_RESET_COMMAND_TIMEOUT:
+    kickTimeout_();
+    break;
+  case CMD_MULTI_DEVICE_ERROR_CHECK:
+    if (device_ >= d[0] && device_ < (uint16_t)(d[0] + d[1]))
+    {
+      // raw byte, never CRC'd
+      tx_.push_back(errorActive_() ? ERROR_CHECK_DONE : ERROR_CHECK_CONTINUE);
+      c_.responses++;
+    }
+    break;
+  case CMD_MULTI_DEVICE_WRITE:
+  {
+    const uint8_t start = d[0], count = d[1], per = d[2], sub = d[3] | 0x80;
+    if (device_ < start || device_ >= (uint16_t)(start + count))
+      break;
+    if (sub == CMD_MULTI_DEVICE_WRITE || sub == CMD_MULTI_DEVICE_ERROR_CHECK ||
+        dataLength_(sub, nullptr, 0) != per)
+    {
+      ok = false;
+      break;
+    }
+    c_.frames--; // counted by the nested command
+    execute_(sub, d + 4 + (size_t)(device_ - start) * per, per);
+    break;
+  }
+  default:
+    ok = false;
+  }
+  (void)n;
+  if (!ok)
+    protocolError_();
+}
+
+// ---- time ----
+
+// One 10 ms accel/decel step toward 'tgt' (0 limits = immediate)
+static int16_t approach(int16_t cur, int16_t tgt, uint16_t acc_f, uint16_t acc_r,
+                        uint16_t dec_f, uint16_t dec_r)
+{
+  // opposite sign (or toward zero): decelerate first
+  if ((cur > 0 && tgt < cur) || (cur < 0 && tgt > cur))
+  {
+    const bool fwd = cur > 0;
+    const int16_t stop = fwd ? std::max<int16_t>(tgt, 0) : std::min<int16_t>(tgt, 0);
+    const uint16_t lim = fwd ? dec_f : dec_r;
+    if (lim)
+      return fwd ? std::max<int16_t>(stop, cur - lim) : std::min<int16_t>(stop, cur + lim);
+    cur = stop;
+    if (cur == tgt)
+      return cur;
+  }
+  if (tgt > cur)
+    return acc_f ? std::min<int>(tgt, cur + acc_f) : tgt;
+  if (tgt < cur)
+    return acc_r ? std::max<int>(tgt, cur - acc_r) : tgt;
+  return cur;
+}
+
+void MotoronEmulator::tick(double dt_s)
+{
+  std::lock_guard<std::mutex> lk(m_);
+  since_cmd_s_ += dt_s;
+  if (timeout_ && since_cmd_s_ >= timeout_ * 0.004 &&
+      !(flags_ & (1 << STATUS_FLAG_COMMAND_TIMEOUT)))
+  {
+    flags_ |= (1 << STATUS_FLAG_COMMAND_TIMEOUT) | (1 << STATUS_FLAG_COMMAND_TIMEOUT_LATCHED);
+    c_.timeouts++;
+  }
+
+  const bool err = errorActive_();
+  if (err && error_response_ >= 2) // coast/brake now
+    for (auto &m : mv_)
+      m.current = 0;
+
+  accel_acc_s_ += dt_s;
+  while (accel_acc_s_ >= kUpdatePeriod)
+  {
+    accel_acc_s_ -= kUpdatePeriod;
+    for (auto &m : mv_)
+      m.current = approach(m.current, err ? 0 : m.target, m.accel_fwd, m.accel_rev,
+                           m.decel_fwd, m.decel_rev);
+  }
+}
+
+// ---- inspection ----
+
+uint16_t MotoronEmulator::statusFlags() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return flags_now_();
+}
+uint8_t MotoronEmulator::protocolOptions() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return options_;
+}
+uint16_t MotoronEmulator::commandTimeout() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return timeout_;
+}
+uint16_t MotoronEmulator::errorMask() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return error_mask_;
+}
+int16_t MotoronEmulator::targetSpeed(int motor) const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return mv_[motor - 1].target;
+}
+int16_t MotoronEmulator::currentSpeed(int motor) const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return mv_[motor - 1].current;
+}
+int16_t MotoronEmulator::bufferedSpeed(int motor) const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return mv_[motor - 1].buffered;
+}
+MotoronEmulator::Counters MotoronEmulator::counters() const
+{
+  std::lock_guard<std::mutex> lk(m_);
+  return c_;
+}
+
+// ---- transports ----
+
+int EmulatorTransport::tryWrite(const uint8_t *data, size_t n) noexcept
+{
+  uint32_t f = fail_.load(std::memory_order_relaxed);
+  if (f)
+  {
+    fail_.store(f - 1, std::memory_order_relaxed);
+    failed_.fetch_add(1, std::memory_order_relaxed);
+    return EREMOTEIO; // what i2c-dev reports for a NACK
+  }
+  emu_.receive(data, n);
+  emu_.endTransaction();
+  return 0;
+}
+
+int EmulatorTransport::tryRead(uint8_t *data, size_t n) noexcept
+{
+  if (emu_.pendingResponse() < n)
+    return EREMOTEIO;
+  emu_.respond(data, n);
+  const uint32_t c = corrupt_.load(std::memory_order_relaxed);
+  if (c && n)
+  {
+    corrupt_.store(c - 1, std::memory_order_relaxed);
+    data[0] ^= 0x10;
+  }
+  return 0;
+}
+
+int EmulatorTransport::reopen() noexcept
+{
+  reopens_.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+MotoronPtyServer::MotoronPtyServer(MotoronEmulator &emu) : emu_(emu)
+{
+  master_ = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_ < 0 || grantpt(master_) < 0 || unlockpt(master_) < 0)
+  {
+    const int e = errno;
+    if (master_ >= 0)
+      ::close(master_);
+    throw std::runtime_error(std::string("posix_openpt: ") + std::strerror(e));
+  }
+  slave_ = ptsname(master_);
+  // hold the slave open in raw mode: no echo back into the emulator, and
+  // no EIO on the master while a client reconnects
+  hold_ = ::open(slave_.c_str(), O_RDWR | O_NOCTTY);
+  if (hold_ < 0)
+  {
+    const int e = errno;
+    ::close(master_);
+    throw std::runtime_error(std::string("open ") + slave_ + ": " + std::strerror(e));
+  }
+  termios tio;
+  if (tcgetattr(hold_, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(hold_, TCSANOW, &tio);
+  }
+  th_ = std::thread([this]
+                    { loop_(); });
+}
+
+MotoronPtyServer::~MotoronPtyServer()
+{
+  stop();
+  if (hold_ >= 0)
+    ::close(hold_);
+  if (master_ >= 0)
+    ::close(master_);
+}
+
+void MotoronPtyServer::stop()
+{
+  run_.store(false);
+  if (th_.joinable())
+    th_.join();
+}
+
+// The server owns the board clock; an idle line ends a pending frame
+void MotoronPtyServer::loop_()
+{
+  using clk = std::chrono::steady_clock;
+  auto last = clk::now();
+  uint8_t buf[256];
+  while (run_.load())
+  {
+    pollfd p{master_, POLLIN, 0};
+    int r = poll(&p, 1, 2);
+    if (r > 0 && (p.revents & POLLIN))
+    {
+      ssize_t got = ::read(master_, buf, sizeof(buf));
+      if (got > 0)
+        emu_.receive(buf, (size_t)got);
+    }
+    else if (r == 0)
+      emu_.endTransaction();
+
+    size_t n;
+    while ((n = emu_.respond(buf, sizeof(buf))) > 0)
+      if (::write(master_, buf, n) < 0)
+        break;
+
+    auto now = clk::now();
+    emu_.tick(std::chrono::duration<double>(now - last).count());
+    last = now;
+  }
+}
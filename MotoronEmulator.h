@@ -0,0 +1,168 @@
+// MotoronEmulator.h
+#pragma once
+#include "MotoronTransport.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Software model of a Motoron M3H256 (3 channels) at the command-protocol
+// level, for bus-level tests and benchmarks without hardware.
+//
+// Covered: compact and Pololu (0xAA) framing, CRC for commands/responses,
+// protocol options, general and per-motor variables, command timeout,
+// buffered speeds, multi-device write/error check (serial), status flags
+// and the error mask, and accel/decel limits on the current speed.
+// Not modelled: current sensing, VIN, braking PWM, starting speed,
+// direction change delay, 7-bit serial responses, 14-bit device numbers.
+class MotoronEmulator
+{
+public:
+  static constexpr int kMotors = 3;
+  static constexpr uint16_t kProductId = 0x00CC;
+
+  enum class Bus
+  {
+    I2C,   // frames end with the write transaction (endTransaction)
+    Serial // byte stream; Pololu 0xAA and multi-device commands allowed
+  };
+
+  struct Counters
+  {
+    uint64_t bytes = 0;
+    uint64_t frames = 0; // commands executed
+    uint64_t crc_errors = 0;
+    uint64_t protocol_errors = 0;
+    uint64_t responses = 0;
+    uint64_t timeouts = 0;
+  };
+
+  explicit MotoronEmulator(Bus bus = Bus::I2C, uint16_t device_number = 16);
+
+  // Host -> board bytes
+  void receive(const uint8_t *data, size_t n);
+  // I2C stop condition: resolves a trailing optional CRC, drops partial frames
+  void endTransaction();
+  // Board -> host bytes queued by responding commands; returns count copied
+  size_t respond(uint8_t *out, size_t max);
+  size_t pendingResponse() const;
+
+  // Advance the board clock: command timeout and accel/decel limits
+  void tick(double dt_s);
+  // Same as a power cycle: defaults plus the reset flag
+  void powerCycle();
+
+  // Inspection (test side)
+  uint16_t statusFlags() const;
+  uint8_t protocolOptions() const;
+  uint16_t commandTimeout() const; // units of 4 ms
+  uint16_t errorMask() const;
+  int16_t targetSpeed(int motor) const; // motor 1..3
+  int16_t currentSpeed(int motor) const;
+  int16_t bufferedSpeed(int motor) const;
+  Counters counters() const;
+
+private:
+  struct MotorVars
+  {
+    uint8_t pwm_mode = 0;
+    int16_t target = 0;
+    int16_t brake = 0;
+    int16_t current = 0;
+    int16_t buffered = 0;
+    uint16_t accel_fwd = 0, accel_rev = 0; // per 10 ms, 0 = unlimited
+    uint16_t decel_fwd = 0, decel_rev = 0;
+    uint16_t start_fwd = 0, start_rev = 0;
+    uint8_t dir_delay_fwd = 0, dir_delay_rev = 0;
+    uint16_t current_limit = 1000;
+    uint8_t cs_offset = 0, cs_min_divisor = 0;
+  };
+
+  const Bus bus_;
+  uint16_t device_;
+  mutable std::mutex m_;
+
+  // parser state
+  std::vector<uint8_t> frame_; // as received (incl. 0xAA header), for CRC
+  uint8_t cmd_ = 0;            // 0 = idle
+  size_t hdr_ = 0;             // bytes before the command byte (Pololu)
+  size_t need_ = 0;            // data bytes expected after the command byte
+  bool pololu_ = false;
+  bool addressed_ = true;      // Pololu frame for another device
+  bool optional_crc_ = false;  // set_protocol_options/reinit/reset w/o CRC
+  bool skip_ = false;          // after an error: drop data bytes until a command
+
+  // board state
+  uint8_t options_;
+  uint16_t flags_;
+  uint16_t timeout_;
+  uint8_t error_response_;
+  uint16_t error_mask_;
+  MotorVars mv_[kMotors];
+  uint8_t eeprom_[64];
+  double since_cmd_s_ = 0.0;
+  double accel_acc_s_ = 0.0;
+  std::deque<uint8_t> tx_;
+  Counters c_;
+
+  void defaults_();
+  bool errorActive_() const;
+  uint16_t flags_now_() const;
+  size_t dataLength_(uint8_t cmd, const uint8_t *partial, size_t have) const;
+  void byte_(uint8_t b);
+  void startCommand_(uint8_t cmd);
+  void finishFrame_(bool with_crc);
+  void protocolError_();
+  void execute_(uint8_t cmd, const uint8_t *d, size_t n);
+  void reply_(const uint8_t *d, size_t n);
+  void readVars_(uint8_t motor, uint8_t off, uint8_t len);
+  bool setVar_(uint8_t motor, uint8_t off, uint16_t v);
+  bool setSpeed_(uint8_t motor, int16_t v, int which);
+  void kickTimeout_();
+};
+
+// In-process transport: each write is one I2C transaction to the emulator.
+// Fault injection: the next 'n' writes fail like a NACK (nothing delivered);
+// the next 'n' reads arrive with one bit flipped (line noise).
+class EmulatorTransport : public MotoronTransport
+{
+public:
+  explicit EmulatorTransport(MotoronEmulator &emu) : emu_(emu) {}
+  int tryWrite(const uint8_t *data, size_t n) noexcept override;
+  int tryRead(uint8_t *data, size_t n) noexcept override;
+  int reopen() noexcept override;
+  void failNextWrites(uint32_t n) { fail_.store(n, std::memory_order_relaxed); }
+  void corruptNextReads(uint32_t n) { corrupt_.store(n, std::memory_order_relaxed); }
+  uint64_t failedWrites() const { return failed_.load(std::memory_order_relaxed); }
+  uint64_t reopens() const { return reopens_.load(std::memory_order_relaxed); }
+
+private:
+  MotoronEmulator &emu_;
+  std::atomic<uint32_t> fail_{0};
+  std::atomic<uint32_t> corrupt_{0};
+  std::atomic<uint64_t> failed_{0};
+  std::atomic<uint64_t> reopens_{0};
+};
+
+// Serves a Serial-mode emulator on a pty; open slavePath() with FdTransport.
+class MotoronPtyServer
+{
+public:
+  explicit MotoronPtyServer(MotoronEmulator &emu);
+  ~MotoronPtyServer();
+  const std::string &slavePath() const { return slave_; }
+  void stop();
+
+private:
+  MotoronEmulator &emu_;
+  int master_ = -1;
+  int hold_ = -1; // our own slave fd
+  std::string slave_;
+  std::atomic<bool> run_{true};
+  std::thread th_;
+  void loop_();
+};
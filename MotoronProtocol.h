@@ -0,0 +1,126 @@
+// MotoronProtocol.h
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Motoron command encoding and response checking, with the protocol's
+// CRC-7 on commands and responses (protocol options bits 0 and 1).
+//
+// Frames are written into caller buffers of at least kMaxFrame bytes and
+// nothing allocates, so the control thread encodes on its own stack.
+namespace motoron_protocol
+{
+  constexpr std::size_t kMaxFrame = 8; // set_all_speeds_now (3 channels) + CRC
+
+  // One bit at a time: the Motoron's definition (reflected polynomial 0x91)
+  constexpr uint8_t crcBitwise(const uint8_t *d, std::size_t n)
+  {
+    uint8_t c = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      c ^= d[i];
+      for (int b = 0; b < 8; ++b)
+        c = (c & 1) ? (uint8_t)((c ^ 0x91) >> 1) : (uint8_t)(c >> 1);
+    }
+    return c;
+  }
+
+  constexpr std::array<uint8_t, 256> makeCrcTable()
+  {
+    std::array<uint8_t, 256> t{};
+    for (int v = 0; v < 256; ++v)
+    {
+      const uint8_t b = (uint8_t)v;
+      t[v] = crcBitwise(&b, 1);
+    }
+    return t;
+  }
+  // CRC state after one more byte: table[state ^ byte]
+  inline constexpr std::array<uint8_t, 256> kCrcTable = makeCrcTable();
+
+  // one lookup per byte
+  inline uint8_t crc(const uint8_t *d, std::size_t n)
+  {
+    uint8_t c = 0;
+    for (std::size_t i = 0; i < n; ++i)
+      c = kCrcTable[c ^ d[i]];
+    return c;
+  }
+
+  // append the CRC byte if 'with_crc'; the frame length
+  inline std::size_t finish(uint8_t *f, std::size_t n, bool with_crc)
+  {
+    if (with_crc)
+    {
+      f[n] = crc(f, n);
+      ++n;
+    }
+    return n;
+  }
+
+  // speed clamped to [-800, 800]
+  inline std::size_t setSpeedNow(uint8_t *f, uint8_t motor, int16_t speed, bool with_crc)
+  {
+    speed = speed < -800 ? -800 : (speed > 800 ? 800 : speed);
+    f[0] = 0xD2; // CMD_SET_SPEED_NOW
+    f[1] = motor & 0x7F;
+    f[2] = speed & 0x7F;
+    f[3] = (speed >> 7) & 0x7F;
+    return finish(f, 4, with_crc);
+  }
+
+  // all three channels of an M3H256
+  inline std::size_t setAllSpeedsNow(uint8_t *f, int16_t s1, int16_t s2, int16_t s3, bool with_crc)
+  {
+    f[0] = 0xE2; // CMD_SET_ALL_SPEEDS_NOW
+    const int16_t s[3] = {s1, s2, s3};
+    for (int i = 0; i < 3; ++i)
+    {
+      const int16_t v = s[i] < -800 ? -800 : (s[i] > 800 ? 800 : s[i]);
+      f[1 + 2 * i] = v & 0x7F;
+      f[2 + 2 * i] = (v >> 7) & 0x7F;
+    }
+    return finish(f, 7, with_crc);
+  }
+
+  // motor 0: general variables
+  inline std::size_t getVariables(uint8_t *f, uint8_t motor, uint8_t offset, uint8_t length, bool with_crc)
+  {
+    f[0] = 0x9A; // CMD_GET_VARIABLES
+    f[1] = motor & 0x7F;
+    f[2] = offset & 0x7F;
+    f[3] = length & 0x7F;
+    return finish(f, 4, with_crc);
+  }
+
+  inline std::size_t clearLatchedStatusFlags(uint8_t *f, uint16_t flags, bool with_crc)
+  {
+    f[0] = 0xA9; // CMD_CLEAR_LATCHED_STATUS_FLAGS
+    f[1] = flags & 0x7F;
+    f[2] = (flags >> 7) & 0x7F;
+    return finish(f, 3, with_crc);
+  }
+
+  // Always with a CRC byte: the board takes it whether or not it currently
+  // expects CRC (e.g. right after a reset)
+  inline std::size_t setProtocolOptions(uint8_t *f, uint8_t options)
+  {
+    f[0] = 0x8B; // CMD_SET_PROTOCOL_OPTIONS
+    f[1] = options & 0x7F;
+    f[2] = ~options & 0x7F;
+    return finish(f, 3, true);
+  }
+
+  // bytes to read for a response of 'length' payload bytes
+  constexpr std::size_t responseSize(std::size_t length, bool with_crc)
+  {
+    return length + (with_crc ? 1 : 0);
+  }
+
+  // the CRC byte after 'length' payload bytes matches (always true without CRC)
+  inline bool checkResponse(const uint8_t *r, std::size_t length, bool with_crc)
+  {
+    return !with_crc || crc(r, length) == r[length];
+  }
+}
@@ -0,0 +1,169 @@
+// MotoronTransport.cpp
+#include "MotoronTransport.h"
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+void MotoronTransport::write(const uint8_t *data, size_t n)
+{
+  if (int e = tryWrite(data, n))
+    throw std::runtime_error(std::string("motoron write: ") + std::strerror(e));
+}
+
+void MotoronTransport::read(uint8_t *data, size_t n)
+{
+  if (int e = tryRead(data, n))
+    throw std::runtime_error(std::string("motoron read: ") + std::strerror(e));
+}
+
+// ---- I2C ----
+
+I2CTransport::I2CTransport(const std::string &dev, uint8_t addr)
+    : dev_(dev), addr_(addr), fd_(-1)
+{
+  if (int e = open_())
+    throw std::runtime_error(std::string("open ") + dev + ": " + std::strerror(e));
+}
+
+I2CTransport::~I2CTransport()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+int I2CTransport::open_() noexcept
+{
+  fd_ = ::open(dev_.c_str(), O_RDWR);
+  if (fd_ < 0)
+    return errno;
+  if (ioctl(fd_, I2C_SLAVE, addr_) < 0)
+  {
+    const int e = errno;
+    ::close(fd_);
+    fd_ = -1;
+    return e;
+  }
+  return 0;
+}
+
+int I2CTransport::tryWrite(const uint8_t *data, size_t n) noexcept
+{
+  if (fd_ < 0)
+    return EBADF;
+  ssize_t w = ::write(fd_, data, n);
+  if (w < 0)
+    return errno;
+  return w == (ssize_t)n ? 0 : EIO;
+}
+
+int I2CTransport::tryRead(uint8_t *data, size_t n) noexcept
+{
+  if (fd_ < 0)
+    return EBADF;
+  ssize_t r = ::read(fd_, data, n);
+  if (r < 0)
+    return errno;
+  return r == (ssize_t)n ? 0 : EIO;
+}
+
+// A fresh fd resets the i2c-dev client state. Clearing a stuck bus (SCL
+// pulses) is up to the adapter driver: the kernel's i2c core runs its bus
+// recovery on timeouts where the adapter supports it.
+int I2CTransport::reopen() noexcept
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  return open_();
+}
+
+// ---- serial / pty ----
+
+FdTransport::FdTransport(const std::string &path, int read_timeout_ms)
+    : path_(path), fd_(-1), timeout_ms_(read_timeout_ms)
+{
+  if (int e = open_())
+    throw std::runtime_error(std::string("open ") + path + ": " + std::strerror(e));
+}
+
+FdTransport::~FdTransport()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+int FdTransport::open_() noexcept
+{
+  fd_ = ::open(path_.c_str(), O_RDWR | O_NOCTTY);
+  if (fd_ < 0)
+    return errno;
+  termios tio;
+  if (tcgetattr(fd_, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd_, TCSANOW, &tio);
+  }
+  return 0;
+}
+
+int FdTransport::reopen() noexcept
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  return open_();
+}
+
+int FdTransport::tryWrite(const uint8_t *data, size_t n) noexcept
+{
+  if (fd_ < 0)
+    return EBADF;
+  size_t done = 0;
+  while (done < n)
+  {
+    ssize_t w = ::write(fd_, data + done, n - done);
+    if (w < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    done += (size_t)w;
+  }
+  return 0;
+}
+
+int FdTransport::tryRead(uint8_t *data, size_t n) noexcept
+{
+  if (fd_ < 0)
+    return EBADF;
+  size_t done = 0;
+  while (done < n)
+  {
+    pollfd p{fd_, POLLIN, 0};
+    int r = poll(&p, 1, timeout_ms_);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0)
+      return errno;
+    if (r == 0)
+      return ETIMEDOUT;
+    ssize_t got = ::read(fd_, data + done, n - done);
+    if (got < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    if (got == 0)
+      return EIO;
+    done += (size_t)got;
+  }
+  return 0;
+}
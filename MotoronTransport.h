@@ -0,0 +1,60 @@
+// MotoronTransport.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Byte transport under Motoron: one write is one I2C write transaction
+// (or one burst on a serial line).
+//
+// The try* calls never throw and return 0 or an errno value, so the control
+// thread can use them directly; write()/read() throw std::runtime_error.
+class MotoronTransport
+{
+public:
+  virtual ~MotoronTransport() = default;
+  virtual int tryWrite(const uint8_t *data, size_t n) noexcept = 0;
+  // reads exactly n bytes (one I2C read transaction)
+  virtual int tryRead(uint8_t *data, size_t n) noexcept = 0;
+  // drop and re-acquire the device after bus faults (recovery thread only)
+  virtual int reopen() noexcept { return 0; }
+
+  void write(const uint8_t *data, size_t n);
+  void read(uint8_t *data, size_t n);
+};
+
+// Linux i2c-dev: /dev/i2c-N with I2C_SLAVE set to the board address
+class I2CTransport : public MotoronTransport
+{
+public:
+  I2CTransport(const std::string &dev, uint8_t addr);
+  ~I2CTransport() override;
+  int tryWrite(const uint8_t *data, size_t n) noexcept override;
+  int tryRead(uint8_t *data, size_t n) noexcept override;
+  int reopen() noexcept override;
+
+private:
+  std::string dev_;
+  uint8_t addr_;
+  int fd_;
+  int open_() noexcept;
+};
+
+// Any byte-stream fd: a UART tty or a pty (see MotoronPtyServer).
+// Serial frames use the compact protocol (no device number prefix).
+class FdTransport : public MotoronTransport
+{
+public:
+  // opens 'path' O_RDWR|O_NOCTTY and puts it in raw mode
+  explicit FdTransport(const std::string &path, int read_timeout_ms = 100);
+  ~FdTransport() override;
+  int tryWrite(const uint8_t *data, size_t n) noexcept override;
+  int tryRead(uint8_t *data, size_t n) noexcept override;
+  int reopen() noexcept override;
+
+private:
+  std::string path_;
+  int fd_;
+  int timeout_ms_;
+  int open_() noexcept;
+};
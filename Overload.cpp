@@ -0,0 +1,73 @@
+// Overload.cpp
+#include "Overload.h"
+#include <stdexcept>
+
+OverloadManager::OverloadManager() : OverloadManager(Params{}) {}
+
+OverloadManager::OverloadManager(const Params &p) : params_(p)
+{
+  if (params_.periods.empty() || params_.periods.size() > 255)
+    throw std::invalid_argument("OverloadManager: need 1..255 periods");
+  if (params_.window_iters == 0)
+    throw std::invalid_argument("OverloadManager: window_iters must be > 0");
+}
+
+void OverloadManager::observe(bool missed, std::chrono::nanoseconds busy)
+{
+  ++iters_;
+  if (missed)
+    ++misses_;
+  if (busy > worst_busy_)
+    worst_busy_ = busy;
+
+  // Step down immediately once the window's miss budget is exhausted
+  if (misses_ >= params_.miss_threshold && level_ + 1u < params_.periods.size())
+  {
+    setLevel_(level_ + 1, misses_);
+    iters_ = misses_ = 0;
+    worst_busy_ = std::chrono::nanoseconds(0);
+    clean_windows_ = 0;
+    return;
+  }
+
+  if (iters_ < params_.window_iters)
+    return;
+
+  // End of window: count clean windows that would also fit the faster rate
+  if (level_ > 0)
+  {
+    const auto faster = params_.periods[level_ - 1];
+    const bool fits = worst_busy_.count() < params_.recover_util * faster.count();
+    if (misses_ == 0 && fits)
+    {
+      if (++clean_windows_ >= params_.recover_windows)
+      {
+        setLevel_(level_ - 1, 0);
+        clean_windows_ = 0;
+      }
+    }
+    else
+    {
+      clean_windows_ = 0;
+    }
+  }
+
+  iters_ = misses_ = 0;
+  worst_busy_ = std::chrono::nanoseconds(0);
+}
+
+void OverloadManager::setLevel_(uint8_t to, uint32_t misses)
+{
+  Transition tr;
+  tr.t_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+  tr.from = level_;
+  tr.to = to;
+  tr.misses = misses;
+  tr.period_ns = params_.periods[to].count();
+  log_.push(tr); // dropped if housekeeping stops draining; level still changes
+
+  level_ = to;
+  level_pub_.store(to, std::memory_order_relaxed);
+}
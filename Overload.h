@@ -0,0 +1,71 @@
+// Overload.h
+#pragma once
+#include "Ring.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Steps a periodic loop down to slower rates on sustained deadline misses
+// and back up once it has headroom again.
+//
+// Level 0 is full rate; each higher level uses the next (longer) period.
+// The loop asks period() for the deadline to pass to ThreadMonitor::end_iter
+// and reports every iteration via observe(). Other threads check
+// shedNonCritical() to skip status polling / telemetry while degraded.
+class OverloadManager
+{
+public:
+  struct Params
+  {
+    // periods per level, fastest first (e.g. 1 kHz, 500 Hz, 250 Hz)
+    std::vector<std::chrono::nanoseconds> periods{
+        std::chrono::microseconds(1000),
+        std::chrono::microseconds(2000),
+        std::chrono::microseconds(4000)};
+    uint32_t window_iters{100};   // iterations per evaluation window
+    uint32_t miss_threshold{5};   // misses in one window => step down
+    uint32_t recover_windows{20}; // clean windows in a row => step up
+    double recover_util{0.6};     // worst busy / faster period must be below this to step up
+  };
+
+  struct Transition
+  {
+    int64_t t_ns;   // steady_clock time of the change
+    uint8_t from;   // level before
+    uint8_t to;     // level after
+    uint32_t misses; // misses in the window that triggered it
+    int64_t period_ns; // new period
+  };
+
+  OverloadManager();
+  explicit OverloadManager(const Params &p);
+
+  // --- loop thread ---
+  // period to use for the next iteration
+  std::chrono::nanoseconds period() const { return params_.periods[level_]; }
+  // call once per iteration after end_iter
+  void observe(bool missed, std::chrono::nanoseconds busy);
+
+  // --- any thread ---
+  uint8_t level() const { return level_pub_.load(std::memory_order_relaxed); }
+  bool shedNonCritical() const { return level() != 0; }
+  int64_t periodNs(uint8_t level) const { return params_.periods[level].count(); }
+  // drain recorded transitions (single consumer)
+  bool popTransition(Transition &out) { return log_.pop(out); }
+
+private:
+  void setLevel_(uint8_t to, uint32_t misses);
+
+  Params params_;
+  uint8_t level_{0};
+  std::atomic<uint8_t> level_pub_{0};
+
+  // current window
+  uint32_t iters_{0};
+  uint32_t misses_{0};
+  std::chrono::nanoseconds worst_busy_{0};
+  uint32_t clean_windows_{0};
+
+  SpscRing<Transition, 64> log_;
+};
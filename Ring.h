@@ -0,0 +1,91 @@
+// Ring.h
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer / single-consumer ring. Lock-free and
+// allocation-free; push() from the producing (RT) thread, pop() from one
+// consumer. When full, push() drops the new item and returns false.
+template <typename T, std::size_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  bool push(const T &v)
+  {
+    const std::size_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) == N)
+      return false;
+    buf_[h & (N - 1)] = v;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &out)
+  {
+    const std::size_t t = tail_.load(std::memory_order_relaxed);
+    if (t == head_.load(std::memory_order_acquire))
+      return false;
+    out = buf_[t & (N - 1)];
+    tail_.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<T, N> buf_{};
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// Single-producer ring that never waits for its readers: put() overwrites
+// the oldest slot, so the producer never reads reader state.
+//
+// put() claims the slot by publishing the new head before copying into it.
+// A reader treats everything below head() - 1 as complete and re-reads the
+// head after copying; if the producer has come back around to that slot by
+// then, read() reports the item as lost.
+template <typename T, std::size_t N>
+class TapRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "TapRing size must be a power of two");
+
+public:
+  using value_type = T;
+  static constexpr std::size_t kCapacity = N;
+
+  void put(const T &v)
+  {
+    const std::size_t h = head_.load(std::memory_order_relaxed);
+    head_.store(h + 1, std::memory_order_release); // item h-1 complete, slot h claimed
+    std::atomic_thread_fence(std::memory_order_release);
+    buf_[h & (N - 1)] = v;
+  }
+
+  // items [0, end()) are complete; the one being written is excluded
+  std::size_t end() const
+  {
+    const std::size_t h = head_.load(std::memory_order_acquire);
+    return h ? h - 1 : 0;
+  }
+
+  // false if 'seq' is not complete yet or was overwritten
+  bool read(std::size_t seq, T &out) const
+  {
+    if (seq >= end())
+      return false;
+    out = buf_[seq & (N - 1)];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return head_.load(std::memory_order_relaxed) - seq <= N;
+  }
+
+private:
+  std::array<T, N> buf_{};
+  alignas(64) std::atomic<std::size_t> head_{0};
+};
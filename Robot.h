@@ -0,0 +1,424 @@
+// Robot.h
+#pragma once
+#include "Motor.h"
+#include "Motoron.h"
+#include "BusSupervisor.h"
+#include "EncoderSampler.h"
+#include "EncoderBank.h"
+#include "TickProfiler.h"
+#include "LatencyTrace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// One Motoron board on the bus
+struct DriverConfig
+{
+  const char *i2c_dev; // e.g. "/dev/i2c-1"
+  uint8_t addr;        // 7-bit I2C address
+};
+
+// One axis: encoder lines, scaling, driver mapping and PID gains
+struct AxisConfig
+{
+  int enc_a;             // encoder A line offset
+  int enc_b;             // encoder B line offset
+  double counts_per_rev; // 4x quadrature counts per motor rev
+  double gear;           // >1 means reduction
+  uint8_t driver;        // index into Config::drivers
+  uint8_t channel;       // Motoron channel (1..3)
+  double kp, ki, kd;
+  unsigned debounce_us;         // debounce window; lower bound when adaptive
+  unsigned debounce_max_us = 0; // > debounce_us: adapt up to this (AdaptiveDebounce)
+};
+
+// High-rate sampling decode shared by all encoders (see EncoderSampler)
+struct SamplerConfig
+{
+  bool enabled;
+  bool use_gpiomem;   // true: mmap /dev/gpiomem; false: gpiod_line_get_value_bulk
+  int cpu;            // isolated core for the sampler thread (-1: no pinning)
+  unsigned period_ns; // sample period (0: busy-poll)
+  double up_eps;      // edges/s per encoder to switch to sampling
+  double down_eps;    // edges/s per encoder to switch back to interrupts
+};
+
+// Bus fault handling for all drivers (see Motoron::trySetSpeed, BusSupervisor)
+struct BusConfig
+{
+  unsigned retry_budget_us; // per tick, shared by all writes of that tick
+  uint32_t fail_limit;      // consecutive failed writes before recovery
+  unsigned status_poll_ms;  // reset-flag check interval (0: off)
+};
+
+// Compile-time robot topology.
+//
+// Config is a struct of constexpr data:
+//   static constexpr const char *chip;                       // gpiochip path
+//   static constexpr std::array<DriverConfig, ND> drivers;
+//   static constexpr std::array<AxisConfig, NA> axes;
+//   static constexpr SamplerConfig sampler;
+//   static constexpr BusConfig bus;
+//
+// Drivers and motors live in contiguous std::arrays sized from Config, the
+// per-axis loops are unrolled with fold expressions, and scale factors are
+// folded at compile time. Nothing is allocated after construction.
+// Encoder counters sit in one EncoderBank, so every tick uses counts of all
+// axes read at the same instant. Bus writes never throw out of update(): a
+// board that keeps failing (or reports a reset) is recovered by a
+// BusSupervisor thread while the other boards keep being driven.
+template <typename Config>
+class Robot
+{
+public:
+  static constexpr std::size_t kAxes = Config::axes.size();
+  static constexpr std::size_t kDrivers = Config::drivers.size();
+  static constexpr int64_t kRetryBudgetNs = (int64_t)Config::bus.retry_budget_us * 1000;
+  static constexpr int64_t kStatusPollNs = (int64_t)Config::bus.status_poll_ms * 1000000;
+
+  static_assert(kAxes > 0, "Robot needs at least one axis");
+  static_assert(kDrivers > 0, "Robot needs at least one driver");
+
+  Robot()
+      : drivers_(makeDrivers(std::make_index_sequence<kDrivers>{})),
+        motors_(makeMotors(std::make_index_sequence<kAxes>{}))
+  {
+    init_();
+  }
+
+  // boards on the given transports instead of Config::drivers (tests:
+  // EmulatorTransport)
+  explicit Robot(std::array<std::unique_ptr<MotoronTransport>, kDrivers> transports)
+      : drivers_(makeDrivers(transports, std::make_index_sequence<kDrivers>{})),
+        motors_(makeMotors(std::make_index_sequence<kAxes>{}))
+  {
+    init_();
+  }
+
+  Robot(const Robot &) = delete;
+  Robot &operator=(const Robot &) = delete;
+
+  // Sample + PID for every axis, then write every command to the bus, so all
+  // encoders are read before any I2C traffic delays the later axes.
+  void update(double dt_s)
+  {
+    update(dt_s, std::make_index_sequence<kAxes>{});
+  }
+
+  // per-phase timing of update(); nullptr (default) disables it
+  void setProfiler(TickProfiler *p)
+  {
+    static_assert(kAxes <= TickProfiler::kMaxAxes, "TickProfiler::kMaxAxes too small");
+    prof_ = p;
+  }
+
+  // edge-to-actuation records of every consumed encoder edge go to 'w'
+  // (nullptr: off). Records start with the edges after the next update()
+  void setTracer(LatencyTrace::Writer *w)
+  {
+    trace_ = w;
+    trace_resync_ = true;
+  }
+
+  // Event-triggered control: the decoders signal the returned wake once an
+  // axis has moved 'threshold' counts since the last update(). Allocates
+  // the wake on first use; it lives as long as the encoders.
+  EncoderWake &enableWake(int32_t threshold)
+  {
+    if (!wake_)
+      wake_ = std::make_unique<EncoderWake>();
+    bank_.setWake(wake_.get(), threshold);
+    return *wake_;
+  }
+  void disableWake() { bank_.setWake(nullptr, 0); }
+  // arm the wake against the counts of the last update(); false if an axis
+  // has already moved far enough (update again instead of sleeping)
+  bool armWake() { return wake_ && bank_.armWake(*wake_, snap_.counts); }
+
+  // Idle axes: update() skips the bus write of an axis in 'mask' (bit i)
+  // while its command equals what its board last accepted, unless that
+  // board has had no write for refresh_ns (the Motoron command timeout
+  // would stop it). mask 0: every axis is written every tick.
+  // While its count and reference stay as they were at the last update(),
+  // a held axis also skips its PID, so the integrator cannot wind up on the
+  // residual error and move the command
+  void setHeld(uint32_t mask, int64_t refresh_ns)
+  {
+    static_assert(kAxes <= 32, "held-axis mask is 32 bits");
+    held_ = mask;
+    refresh_ns_ = refresh_ns;
+    for (std::size_t i = 0; i < kAxes; ++i)
+    {
+      held_counts_[i] = snap_.counts[i];
+      held_ref_[i] = axis(i).reference();
+    }
+  }
+  uint64_t heldWrites() const { return held_writes_.load(std::memory_order_relaxed); }
+
+  // on the thread that calls update(); held axes are written again
+  void enable(bool en)
+  {
+    for (auto &m : motors_)
+      m.enable(en);
+    written_.fill(std::numeric_limits<double>::quiet_NaN());
+  }
+
+  // best effort on every board; a board in recovery is left to its
+  // command timeout
+  void coastAll()
+  {
+    const int64_t deadline = Motoron::nowNs() + 4 * kRetryBudgetNs;
+    for (auto &d : drivers_)
+      d.tryCoastAll(deadline);
+  }
+
+  // read one board's status flags (round robin) over the next two ticks;
+  // a set reset flag sends that board to recovery
+  void pollDriverStatus() { poll_due_ = true; }
+
+  template <std::size_t I>
+  Motor &axis()
+  {
+    static_assert(I < kAxes, "axis index out of range");
+    return std::get<I>(motors_);
+  }
+  Motor &axis(std::size_t i) { return motors_[i]; }
+  const Motor &axis(std::size_t i) const { return motors_[i]; }
+
+  Motoron &driver(std::size_t i) { return drivers_[i]; }
+  const EncoderBank<kAxes> &encoders() const { return bank_; }
+  // snapshot used by the last update()
+  const EncoderSnapshot<kAxes> &lastSnapshot() const { return snap_; }
+  const EncoderSampler *sampler() const { return sampler_ ? &*sampler_ : nullptr; }
+
+  static constexpr std::size_t size() { return kAxes; }
+
+private:
+  static constexpr bool validAxes()
+  {
+    for (const auto &a : Config::axes)
+    {
+      if (a.driver >= kDrivers || a.channel < 1 || a.channel > 3 ||
+          !(a.counts_per_rev > 0.0) || !(a.gear > 0.0) ||
+          (a.debounce_max_us && a.debounce_max_us < a.debounce_us))
+        return false;
+    }
+    return true;
+  }
+  static_assert(validAxes(), "Config::axes: bad driver index, channel, CPR, gear or debounce range");
+
+  // Output revolutions per encoder count, folded at compile time
+  template <std::size_t I>
+  static constexpr double kRevPerCount =
+      1.0 / (Config::axes[I].counts_per_rev * Config::axes[I].gear);
+
+  void init_()
+  {
+    for (auto &d : drivers_)
+    {
+      d.initBasic(); // a missing board at startup is still fatal
+      d.setFailLimit(Config::bus.fail_limit);
+      supervisor_.attach(d);
+    }
+    supervisor_.start();
+    configure(std::make_index_sequence<kAxes>{});
+    if (Config::sampler.enabled)
+      startSampler();
+  }
+
+  template <std::size_t... I>
+  static std::array<Motoron, kDrivers> makeDrivers(std::index_sequence<I...>)
+  {
+    return {{Motoron(Config::drivers[I].i2c_dev, Config::drivers[I].addr)...}};
+  }
+  template <std::size_t... I>
+  static std::array<Motoron, kDrivers> makeDrivers(std::array<std::unique_ptr<MotoronTransport>, kDrivers> &t,
+                                                   std::index_sequence<I...>)
+  {
+    return {{Motoron(std::move(t[I]))...}};
+  }
+
+  template <std::size_t... I>
+  std::array<Motor, kAxes> makeMotors(std::index_sequence<I...>)
+  {
+    return {{Motor(Config::chip, Config::axes[I].enc_a, Config::axes[I].enc_b,
+                   drivers_[Config::axes[I].driver], Config::axes[I].channel,
+                   Config::axes[I].debounce_us, &bank_[I])...}};
+  }
+
+  template <std::size_t... I>
+  void configure(std::index_sequence<I...>)
+  {
+    ((std::get<I>(motors_).setRevPerCount(kRevPerCount<I>),
+      std::get<I>(motors_).setPID(Config::axes[I].kp, Config::axes[I].ki, Config::axes[I].kd),
+      std::get<I>(motors_).encoder().setDebounceRange(
+          Config::axes[I].debounce_us, std::max(Config::axes[I].debounce_us, Config::axes[I].debounce_max_us))),
+     ...);
+  }
+
+  void startSampler()
+  {
+    std::unique_ptr<GpioLevelSource> src;
+    if (Config::sampler.use_gpiomem)
+      src = std::make_unique<GpioMemSource>();
+    else
+      src = std::make_unique<GpiodBulkSource>();
+
+    EncoderSampler::Params p;
+    p.period = std::chrono::nanoseconds(Config::sampler.period_ns);
+    p.cpu = Config::sampler.cpu;
+    p.up_eps = Config::sampler.up_eps;
+    p.down_eps = Config::sampler.down_eps;
+    sampler_.emplace(std::move(src), p);
+    for (auto &m : motors_)
+      sampler_->attach(m.encoder());
+    sampler_->start();
+  }
+
+  template <std::size_t... I>
+  void update(double dt_s, std::index_sequence<I...>)
+  {
+    using Phase = TickProfiler::Phase;
+    TickProfiler::Scope tick(prof_, Phase::Tick, 0);
+    timed(Phase::Read, 0, [&] { snap_ = bank_.snapshotAll(); });
+    const bool tracing = traceBegin_();
+    (timed(Phase::Sample, I, [&] { std::get<I>(motors_).sample(snap_.counts[I]); }), ...);
+    (timed(Phase::Pid, I, [&] { if (!frozen_<I>()) std::get<I>(motors_).step(dt_s); traceStamp_(tracing, I, &LatencyTrace::Record::pid_ns); }), ...);
+    const int64_t deadline = Motoron::nowNs() + kRetryBudgetNs;
+    collectStatus_();
+    (timed(Phase::Bus, I, [&] { commit_<I>(deadline); traceStamp_(tracing, I, &LatencyTrace::Record::bus_ns); }), ...);
+    requestStatus_(deadline);
+    if (tracing)
+      traceEnd_();
+  }
+
+  // held, not moved and no new reference since setHeld()
+  template <std::size_t I>
+  bool frozen_() const
+  {
+    return ((held_ >> I) & 1) && snap_.counts[I] == held_counts_[I] &&
+           std::get<I>(motors_).reference() == held_ref_[I];
+  }
+
+  template <std::size_t I>
+  void commit_(int64_t deadline)
+  {
+    constexpr std::size_t D = Config::axes[I].driver;
+    Motor &m = std::get<I>(motors_);
+    const int64_t now = deadline - kRetryBudgetNs;
+    if (((held_ >> I) & 1) && m.command() == written_[I] && now - board_write_ns_[D] < refresh_ns_)
+    {
+      held_writes_.store(held_writes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    if (m.commit(deadline))
+    {
+      written_[I] = m.command();
+      board_write_ns_[D] = now;
+    }
+    else
+      written_[I] = std::numeric_limits<double>::quiet_NaN(); // unknown: write again
+  }
+
+  // axes whose snapshot holds an edge not traced yet; false if none
+  bool traceBegin_()
+  {
+    if (!trace_)
+      return false;
+    ++trace_tick_;
+    if (trace_resync_)
+    {
+      trace_resync_ = false;
+      last_edge_ = snap_.edge_ns;
+      return false;
+    }
+    bool any = false;
+    for (std::size_t i = 0; i < kAxes; ++i)
+    {
+      traced_[i] = snap_.edge_ns[i] != last_edge_[i];
+      any |= traced_[i];
+    }
+    return any;
+  }
+  void traceStamp_(bool tracing, std::size_t i, int64_t LatencyTrace::Record::*stage)
+  {
+    if (tracing && traced_[i])
+      trace_rec_[i].*stage = Motoron::nowNs();
+  }
+  void traceEnd_()
+  {
+    for (std::size_t i = 0; i < kAxes; ++i)
+    {
+      if (!traced_[i])
+        continue;
+      LatencyTrace::Record &r = trace_rec_[i];
+      r.tick = trace_tick_;
+      r.edge_ns = snap_.edge_ns[i];
+      r.decode_ns = snap_.decode_lag_ns[i] < 0 ? 0 : snap_.edge_ns[i] + snap_.decode_lag_ns[i];
+      r.sample_ns = snap_.t_ns;
+      r.axis = (uint16_t)i;
+      r.writer = trace_->id();
+      trace_->push(r);
+      last_edge_[i] = snap_.edge_ns[i];
+    }
+  }
+
+  // The response is read on the tick after the request, before that
+  // board's commands, so nothing else reaches it in between
+  void requestStatus_(int64_t deadline)
+  {
+    if (!poll_due_)
+      return;
+    poll_due_ = false;
+    poll_next_ = (poll_next_ + 1) % kDrivers;
+    if (drivers_[poll_next_].requestStatus(deadline))
+      polling_ = poll_next_;
+  }
+  void collectStatus_()
+  {
+    if (polling_ == kDrivers)
+      return;
+    drivers_[polling_].collectStatus();
+    polling_ = kDrivers;
+  }
+
+  // one scope per call, so each fold element is timed on its own
+  template <typename F>
+  void timed(TickProfiler::Phase p, std::size_t axis, F &&f)
+  {
+    TickProfiler::Scope s(prof_, p, axis);
+    f();
+  }
+
+  std::array<Motoron, kDrivers> drivers_; // must precede motors_ (motors hold references)
+  BusSupervisor supervisor_;              // after drivers_: stopped before they go away
+  std::unique_ptr<EncoderWake> wake_;     // before motors_: decoders may signal it until they stop
+  EncoderBank<kAxes> bank_;               // likewise: encoders write into its slots
+  std::array<Motor, kAxes> motors_;
+  EncoderSnapshot<kAxes> snap_{};
+  TickProfiler *prof_{nullptr};
+  LatencyTrace::Writer *trace_{nullptr};
+  bool trace_resync_{false};
+  uint64_t trace_tick_{0};
+  std::array<int64_t, kAxes> last_edge_{};
+  std::array<bool, kAxes> traced_{};
+  std::array<LatencyTrace::Record, kAxes> trace_rec_{};
+  uint32_t held_{0};
+  int64_t refresh_ns_{0};
+  std::array<double, kAxes> written_{};      // last command each board accepted
+  std::array<int32_t, kAxes> held_counts_{};  // count / reference when held
+  std::array<double, kAxes> held_ref_{};
+  std::array<int64_t, kDrivers> board_write_ns_{};
+  std::atomic<uint64_t> held_writes_{0};
+  bool poll_due_{false};
+  std::size_t poll_next_{kDrivers - 1};
+  std::size_t polling_{kDrivers}; // board with a status read in flight
+  std::optional<EncoderSampler> sampler_; // after motors_: stopped before encoders go away
+};
@@ -0,0 +1,32 @@
+// RobotConfig.h
+#pragma once
+#include "Robot.h"
+
+// Rig topology: three motors on one Motoron at 0x15.
+// Encoder pins (A,B): (5,6), (12,13), (16,17); 1024 CPR x4; direct drive.
+// Debounce adapts per line between 1 and 20 us.
+struct RigConfig
+{
+  static constexpr const char *chip = "/dev/gpiochip0";
+
+  static constexpr std::array<DriverConfig, 1> drivers{{
+      {"/dev/i2c-1", 0x15},
+  }};
+
+  static constexpr std::array<AxisConfig, 3> axes{{
+      //  A   B   CPR4x  gear drv ch  kp  ki   kd  debounce_us (min, max)
+      {5, 6, 4096.0, 1.0, 0, 1, 10.0, 40.0, 0.1, 1, 20},
+      {12, 13, 4096.0, 1.0, 0, 2, 10.0, 40.0, 0.1, 1, 20},
+      {16, 17, 4096.0, 1.0, 0, 3, 10.0, 40.0, 0.1, 1, 20},
+  }};
+
+  // Encoders switch to sampled decode (100 kHz, core 3) above 20k edges/s
+  // (back below 5k); boot with isolcpus=3 for a quiet core.
+  static constexpr SamplerConfig sampler{true, true, 3, 10000, 20000.0, 5000.0};
+
+  // Bus writes retry for up to 200 us per tick; 8 failed writes in a row hand
+  // the board to recovery; one board's status flags are read every 50 ms.
+  static constexpr BusConfig bus{200, 8, 50};
+};
+
+using RigRobot = Robot<RigConfig>;
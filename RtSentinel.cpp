@@ -0,0 +1,249 @@
+// RtSentinel.cpp
+#include "RtSentinel.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#ifdef RT_SENTINEL
+#include <dlfcn.h>
+#endif
+
+namespace rt_sentinel
+{
+#ifdef RT_SENTINEL
+  namespace
+  {
+    ThreadRecord records[kMaxThreads];
+    // free records, taken from the top; thread start / exit only
+    std::mutex free_mu;
+    int free_idx[kMaxThreads];
+    int n_free = -1; // -1: not filled yet
+    std::atomic<uint64_t> untagged{0};
+    // initial-exec: the hook must not reach __tls_get_addr (which may allocate)
+    thread_local ThreadRecord *tl_record __attribute__((tls_model("initial-exec"))) = nullptr;
+
+    int64_t steadyNs()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+  }
+
+  ThreadRecord *tagCurrentThread(const char *name, bool monitored)
+  {
+    if (tl_record)
+      return tl_record;
+    ThreadRecord *r = nullptr;
+    {
+      std::lock_guard<std::mutex> lk(free_mu);
+      if (n_free < 0)
+        for (n_free = 0; n_free < kMaxThreads; ++n_free)
+          free_idx[n_free] = kMaxThreads - 1 - n_free;
+      if (n_free > 0)
+        r = &records[free_idx[--n_free]];
+    }
+    if (!r)
+    {
+      untagged.fetch_add(1, std::memory_order_relaxed);
+      std::fprintf(stderr, "rt_sentinel: all %d thread records in use, '%s' is not monitored\n",
+                   kMaxThreads, name);
+      return nullptr;
+    }
+    r->allocs.store(0, std::memory_order_relaxed);
+    r->since_ns.store(steadyNs(), std::memory_order_relaxed);
+    r->monitored.store(monitored, std::memory_order_relaxed);
+    r->name.store(name, std::memory_order_release);
+    tl_record = r;
+    return r;
+  }
+
+  void untagCurrentThread()
+  {
+    ThreadRecord *r = tl_record;
+    if (!r)
+      return;
+    tl_record = nullptr;
+    r->name.store(nullptr, std::memory_order_release);
+    std::lock_guard<std::mutex> lk(free_mu);
+    free_idx[n_free++] = (int)(r - records);
+  }
+
+  uint64_t untaggedThreads() { return untagged.load(std::memory_order_relaxed); }
+
+  int unmonitoredThreads(ThreadRecord **out, int max)
+  {
+    int k = 0;
+    for (int i = 0; i < kMaxThreads && k < max; ++i)
+      if (records[i].name.load(std::memory_order_acquire) &&
+          !records[i].monitored.load(std::memory_order_relaxed))
+        out[k++] = &records[i];
+    return k;
+  }
+
+  // allocation-free: runs inside the allocator
+  static inline void note(Kind k, size_t bytes, const void *caller)
+  {
+    ThreadRecord *r = tl_record;
+    if (!r)
+      return;
+    r->allocs.fetch_add(1, std::memory_order_relaxed);
+    Violation v;
+    v.caller = caller;
+    v.bytes = bytes;
+    v.t_ns = steadyNs();
+    v.kind = k;
+    r->recent.push(v);
+  }
+
+  void describe(const void *caller, char *buf, size_t len)
+  {
+    Dl_info info;
+    if (dladdr(caller, &info) && info.dli_sname)
+      std::snprintf(buf, len, "%s+0x%lx", info.dli_sname,
+                    (unsigned long)((const char *)caller - (const char *)info.dli_saddr));
+    else if (dladdr(caller, &info) && info.dli_fname)
+      std::snprintf(buf, len, "%s+0x%lx", info.dli_fname,
+                    (unsigned long)((const char *)caller - (const char *)info.dli_fbase));
+    else
+      std::snprintf(buf, len, "%p", caller);
+  }
+#else
+  ThreadRecord *tagCurrentThread(const char *, bool) { return nullptr; }
+  void untagCurrentThread() {}
+  uint64_t untaggedThreads() { return 0; }
+  int unmonitoredThreads(ThreadRecord **, int) { return 0; }
+  void describe(const void *caller, char *buf, size_t len) { std::snprintf(buf, len, "%p", caller); }
+#endif
+
+  const char *kindName(Kind k)
+  {
+    switch (k)
+    {
+    case Kind::Malloc:
+      return "malloc";
+    case Kind::Calloc:
+      return "calloc";
+    case Kind::Realloc:
+      return "realloc";
+    case Kind::Memalign:
+      return "memalign";
+    case Kind::New:
+      return "new";
+    }
+    return "?";
+  }
+}
+
+#ifdef RT_SENTINEL
+// glibc allocator entry points; wrapping them avoids dlsym() during startup
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void *__libc_memalign(size_t, size_t);
+
+extern "C" void *malloc(size_t n)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Malloc, n, __builtin_return_address(0));
+  return __libc_malloc(n);
+}
+
+extern "C" void *calloc(size_t n, size_t sz)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Calloc, n * sz, __builtin_return_address(0));
+  return __libc_calloc(n, sz);
+}
+
+extern "C" void *realloc(void *p, size_t n)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Realloc, n, __builtin_return_address(0));
+  return __libc_realloc(p, n);
+}
+
+extern "C" int posix_memalign(void **out, size_t align, size_t n)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Memalign, n, __builtin_return_address(0));
+  if (align == 0 || (align & (align - 1)) != 0 || align % sizeof(void *) != 0)
+    return EINVAL;
+  void *p = __libc_memalign(align, n);
+  if (!p)
+    return ENOMEM;
+  *out = p;
+  return 0;
+}
+
+extern "C" void *aligned_alloc(size_t align, size_t n)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Memalign, n, __builtin_return_address(0));
+  return __libc_memalign(align, n);
+}
+
+extern "C" void *memalign(size_t align, size_t n)
+{
+  rt_sentinel::note(rt_sentinel::Kind::Memalign, n, __builtin_return_address(0));
+  return __libc_memalign(align, n);
+}
+
+// operator new records its own caller (the malloc hook would only see libstdc++)
+static void *sentinel_new(size_t n, const void *caller)
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, caller);
+  if (n == 0)
+    n = 1;
+  void *p = __libc_malloc(n);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t n) { return sentinel_new(n, __builtin_return_address(0)); }
+void *operator new[](size_t n) { return sentinel_new(n, __builtin_return_address(0)); }
+void *operator new(size_t n, const std::nothrow_t &) noexcept
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, __builtin_return_address(0));
+  return __libc_malloc(n ? n : 1);
+}
+void *operator new[](size_t n, const std::nothrow_t &) noexcept
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, __builtin_return_address(0));
+  return __libc_malloc(n ? n : 1);
+}
+// aligned new (alignas > __STDCPP_DEFAULT_NEW_ALIGNMENT__: EncoderSlot, SpscRing)
+static void *sentinel_new_aligned(size_t n, std::align_val_t al, const void *caller)
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, caller);
+  void *p = __libc_memalign((size_t)al, n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t n, std::align_val_t al)
+{
+  return sentinel_new_aligned(n, al, __builtin_return_address(0));
+}
+void *operator new[](size_t n, std::align_val_t al)
+{
+  return sentinel_new_aligned(n, al, __builtin_return_address(0));
+}
+void *operator new(size_t n, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, __builtin_return_address(0));
+  return __libc_memalign((size_t)al, n ? n : 1);
+}
+void *operator new[](size_t n, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+  rt_sentinel::note(rt_sentinel::Kind::New, n, __builtin_return_address(0));
+  return __libc_memalign((size_t)al, n ? n : 1);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
@@ -0,0 +1,89 @@
+// RtSentinel.h
+#pragma once
+#include "Ring.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Opt-in hot-path sentinels for RT threads (build with RT_SENTINEL, e.g.
+// `make SENTINEL=1`). A thread tagged with tagCurrentThread() gets every
+// malloc/calloc/realloc, posix_memalign/aligned_alloc/memalign and operator
+// new (plain, aligned, nothrow) on it counted and recorded with the caller's
+// address. Page faults and context switches are sampled per window by
+// ThreadMonitor via getrusage(RUSAGE_THREAD); threads tagged without a
+// ThreadMonitor (the encoder decoders) report allocations only.
+//
+// Without RT_SENTINEL no allocator hook is compiled in and tagging is a no-op.
+namespace rt_sentinel
+{
+  enum class Kind : uint8_t
+  {
+    Malloc,
+    Calloc,
+    Realloc,
+    Memalign, // posix_memalign, aligned_alloc, memalign
+    New
+  };
+
+  struct Violation
+  {
+    const void *caller; // return address of the allocating call
+    size_t bytes;
+    int64_t t_ns; // steady_clock
+    Kind kind;
+  };
+
+  // one per tagged thread; counters written only by that thread. Records
+  // are reused once their thread untags
+  struct ThreadRecord
+  {
+    std::atomic<const char *> name{nullptr}; // nullptr: free
+    std::atomic<bool> monitored{false};      // reported through its ThreadMonitor
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<int64_t> since_ns{0}; // tagged at (steady_clock)
+    SpscRing<Violation, 32> recent;   // drained by housekeeping via pop()
+
+    // housekeeping: next call site of the current owner; entries an earlier
+    // owner left behind are dropped
+    bool pop(Violation &v)
+    {
+      while (recent.pop(v))
+        if (v.t_ns >= since_ns.load(std::memory_order_relaxed))
+          return true;
+      return false;
+    }
+  };
+
+  constexpr bool kEnabled =
+#ifdef RT_SENTINEL
+      true;
+#else
+      false;
+#endif
+
+  constexpr int kMaxThreads = 8;
+
+  // tag the calling thread; nullptr when disabled or out of records (then
+  // reported on stderr and counted in untaggedThreads())
+  ThreadRecord *tagCurrentThread(const char *name, bool monitored = false);
+  // before the tagged thread exits: its record goes back to the free list
+  void untagCurrentThread();
+  // threads that found no free record
+  uint64_t untaggedThreads();
+  // tagged threads without a ThreadMonitor; housekeeping only
+  int unmonitoredThreads(ThreadRecord **out, int max);
+
+  // tags the constructing thread for its scope (thread functions)
+  class ThreadTag
+  {
+  public:
+    explicit ThreadTag(const char *name) { tagCurrentThread(name); }
+    ~ThreadTag() { untagCurrentThread(); }
+    ThreadTag(const ThreadTag &) = delete;
+    ThreadTag &operator=(const ThreadTag &) = delete;
+  };
+
+  // "symbol+0xoff" (or module+offset) for a recorded caller; housekeeping only
+  void describe(const void *caller, char *buf, size_t len);
+  const char *kindName(Kind k);
+}
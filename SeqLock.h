@@ -0,0 +1,56 @@
+// SeqLock.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// Single-writer sequence lock for small trivially-copyable values.
+// The writer never blocks; readers retry while a write is in flight.
+template <typename T>
+class SeqLock
+{
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable T");
+
+public:
+  void store(const T &v)
+  {
+    const uint32_t s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    val_ = v;
+    std::atomic_thread_fence(std::memory_order_release);
+    seq_.store(s + 2, std::memory_order_relaxed);
+  }
+
+  // false if a write was in flight for all attempts; 'out' is then unspecified
+  bool tryLoad(T &out, int attempts = 4) const
+  {
+    for (int i = 0; i < attempts; ++i)
+    {
+      const uint32_t s0 = seq_.load(std::memory_order_acquire);
+      if (s0 & 1u)
+        continue;
+      out = val_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == s0)
+        return true;
+    }
+    return false;
+  }
+
+  T load() const
+  {
+    T out;
+    while (!tryLoad(out))
+    {
+    }
+    return out;
+  }
+
+  // bumps on every store; lets a reader skip unchanged values
+  uint32_t version() const { return seq_.load(std::memory_order_acquire); }
+
+private:
+  std::atomic<uint32_t> seq_{0};
+  T val_{};
+};
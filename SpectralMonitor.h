@@ -0,0 +1,355 @@
+// SpectralMonitor.h
+#pragma once
+#include "Ring.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+// One control tick as seen by the spectral analysis: written by the
+// control thread into a TapRing with a single put() per tick.
+template <std::size_t NAxes>
+struct TrackingSample
+{
+  static constexpr std::size_t kAxes = NAxes;
+  uint32_t period_ns; // control period of this tick (0: not periodic, skipped)
+  float err[NAxes];   // reference - position, revs
+  float cmd[NAxes];   // Motoron speed units
+};
+
+// Frequency band to watch; alarm_rms applies to the tracking error (revs,
+// 0: no alarm)
+struct SpectrumBand
+{
+  double lo_hz;
+  double hi_hz;
+  double alarm_rms;
+};
+
+// Online spectrum of the tracking error and command of every axis, off the
+// control thread.
+//
+// service() pulls the samples written since the last call, and each time a
+// Hann window is full (window samples, advancing by hop) computes the band
+// RMS of every axis from Goertzel powers of the bins inside each band. The
+// transforms run on all axes (error and command) in lockstep, several bins
+// at a time, so the inner loop is a short fixed-size vector loop.
+// A band whose error RMS stays above alarm_rms for alarm_hold windows raises
+// an alarm; it clears below 80% of the limit.
+//
+// The window restarts when the control period changes (overload) or when
+// samples were overwritten before they were read. Samples of event-triggered
+// ticks (period_ns 0) are not analysed.
+template <typename Tap>
+class SpectralMonitor
+{
+public:
+  using Sample = typename Tap::value_type;
+  static constexpr std::size_t kAxes = Sample::kAxes;
+
+  struct Params
+  {
+    std::size_t window{1024}; // samples per transform
+    std::size_t hop{512};     // samples between transforms
+    std::chrono::milliseconds poll{50};
+    unsigned alarm_hold{2};
+    int nice{10}; // analysis thread niceness
+    std::vector<SpectrumBand> bands;
+  };
+
+  struct BandStats
+  {
+    double err_rms{0}; // revs
+    double cmd_rms{0}; // Motoron speed units
+    double peak_hz{0}; // strongest error bin in the band
+    bool alarm{false};
+  };
+
+  struct Report
+  {
+    uint64_t windows{0};  // transforms done
+    uint64_t lost{0};     // samples overwritten before they were read
+    uint64_t restarts{0}; // windows discarded (period change or lost samples)
+    double fs_hz{0};      // sample rate of the last transform
+    std::vector<SpectrumBand> bands;
+    std::vector<std::array<BandStats, kAxes>> band; // [band][axis]
+  };
+
+  struct Alarm
+  {
+    int64_t t_ns; // steady_clock time
+    uint16_t axis;
+    uint16_t band;
+    bool raised; // false: cleared
+    double err_rms;
+    double peak_hz;
+  };
+
+  SpectralMonitor(const Tap &tap, const Params &p)
+      : tap_(tap), params_(p), next_(tap.end())
+  {
+    if (params_.window < 16 || params_.hop == 0 || params_.hop > params_.window)
+      throw std::invalid_argument("SpectralMonitor: bad window/hop");
+    const std::size_t w = params_.window;
+    x_.assign(w * kLanes, 0.0);
+    y_.assign(w * kLanes, 0.0);
+    hann_.resize(w);
+    for (std::size_t n = 0; n < w; ++n)
+    {
+      hann_[n] = 0.5 - 0.5 * std::cos(2.0 * M_PI * (double)n / (double)w);
+      hann_sq_ += hann_[n] * hann_[n];
+    }
+    over_.assign(params_.bands.size(), {});
+    report_.bands = params_.bands;
+    report_.band.assign(params_.bands.size(), {});
+  }
+  ~SpectralMonitor() { stop(); }
+  SpectralMonitor(const SpectralMonitor &) = delete;
+  SpectralMonitor &operator=(const SpectralMonitor &) = delete;
+
+  void start()
+  {
+    if (run_.exchange(true))
+      return;
+    th_ = std::thread(&SpectralMonitor::loop_, this);
+  }
+  void stop()
+  {
+    run_.store(false);
+    if (th_.joinable())
+      th_.join();
+  }
+
+  // pull new samples and run any due transforms (what the thread runs);
+  // returns how many transforms were done
+  std::size_t service()
+  {
+    std::size_t done = 0;
+    const std::size_t end = tap_.end();
+    if (end - next_ >= Tap::kCapacity) // the slot of 'end' is being rewritten too
+    {
+      lost_ += end + 1 - Tap::kCapacity - next_;
+      next_ = end + 1 - Tap::kCapacity;
+      restart_();
+    }
+    Sample s;
+    for (; next_ < end; ++next_)
+    {
+      if (!tap_.read(next_, s))
+      {
+        ++lost_;
+        restart_();
+        continue;
+      }
+      if (s.period_ns == 0) // event-triggered ticks: no uniform sample rate
+      {
+        restart_();
+        continue;
+      }
+      if (s.period_ns != period_ns_)
+      {
+        if (n_)
+          restart_();
+        period_ns_ = s.period_ns;
+      }
+      double *row = &x_[n_ * kLanes];
+      for (std::size_t a = 0; a < kAxes; ++a)
+      {
+        row[a] = s.err[a];
+        row[kAxes + a] = s.cmd[a];
+      }
+      if (++n_ == params_.window)
+      {
+        analyze_();
+        ++done;
+        const std::size_t keep = params_.window - params_.hop;
+        std::memmove(&x_[0], &x_[params_.hop * kLanes], keep * kLanes * sizeof(double));
+        n_ = keep;
+      }
+    }
+    std::lock_guard<std::mutex> lk(m_);
+    report_.lost = lost_;
+    report_.restarts = restarts_;
+    return done;
+  }
+
+  void snapshot(Report &out) const
+  {
+    std::lock_guard<std::mutex> lk(m_);
+    out = report_;
+  }
+  // drain alarm transitions (single consumer)
+  bool popAlarm(Alarm &out) { return alarms_.pop(out); }
+
+private:
+  // error lanes, then command lanes, padded for the vector loop
+  static constexpr std::size_t kLanes = (2 * kAxes + 3) & ~std::size_t(3);
+  static constexpr std::size_t kBinBlock = 4; // bins per Goertzel pass
+
+  void restart_()
+  {
+    if (n_)
+      ++restarts_;
+    n_ = 0;
+  }
+
+  void analyze_()
+  {
+    const std::size_t W = params_.window;
+    const double fs = 1e9 / (double)period_ns_;
+
+    // remove the mean (keeps DC leakage out of the low bands), then window
+    double mean[kLanes] = {};
+    for (std::size_t n = 0; n < W; ++n)
+      for (std::size_t l = 0; l < kLanes; ++l)
+        mean[l] += x_[n * kLanes + l];
+    for (std::size_t l = 0; l < kLanes; ++l)
+      mean[l] /= (double)W;
+    for (std::size_t n = 0; n < W; ++n)
+      for (std::size_t l = 0; l < kLanes; ++l)
+        y_[n * kLanes + l] = (x_[n * kLanes + l] - mean[l]) * hann_[n];
+
+    // one-sided Parseval with the window's power gain
+    const double scale = 2.0 / ((double)W * hann_sq_);
+    std::vector<std::array<BandStats, kAxes>> out(params_.bands.size());
+    for (std::size_t b = 0; b < params_.bands.size(); ++b)
+    {
+      const SpectrumBand &bd = params_.bands[b];
+      const std::size_t k0 = std::max<std::size_t>(1, (std::size_t)std::ceil(bd.lo_hz * W / fs));
+      const std::size_t k1 = std::min<std::size_t>(W / 2 - 1, (std::size_t)std::floor(bd.hi_hz * W / fs));
+      double sum[kLanes] = {};
+      double peak[kAxes] = {};
+      for (std::size_t k = k0; k <= k1; k += kBinBlock)
+      {
+        double p[kBinBlock][kLanes];
+        goertzel_(k, std::min(kBinBlock, k1 + 1 - k), p);
+        for (std::size_t j = 0; j < kBinBlock && k + j <= k1; ++j)
+        {
+          for (std::size_t l = 0; l < kLanes; ++l)
+            sum[l] += p[j][l];
+          for (std::size_t a = 0; a < kAxes; ++a)
+            if (p[j][a] > peak[a])
+            {
+              peak[a] = p[j][a];
+              out[b][a].peak_hz = (double)(k + j) * fs / (double)W;
+            }
+        }
+      }
+      for (std::size_t a = 0; a < kAxes; ++a)
+      {
+        out[b][a].err_rms = std::sqrt(sum[a] * scale);
+        out[b][a].cmd_rms = std::sqrt(sum[kAxes + a] * scale);
+      }
+    }
+    alarms_update_(out);
+
+    std::lock_guard<std::mutex> lk(m_);
+    ++report_.windows;
+    report_.fs_hz = fs;
+    report_.band = out;
+  }
+
+  // |X_k|^2 of bins k .. k+nb-1 for every lane of y_
+  void goertzel_(std::size_t k, std::size_t nb, double (&p)[kBinBlock][kLanes]) const
+  {
+    const std::size_t W = params_.window;
+    double c[kBinBlock];
+    for (std::size_t j = 0; j < kBinBlock; ++j)
+      c[j] = 2.0 * std::cos(2.0 * M_PI * (double)(k + std::min(j, nb - 1)) / (double)W);
+    double s1[kBinBlock][kLanes] = {}, s2[kBinBlock][kLanes] = {};
+    for (std::size_t n = 0; n < W; ++n)
+    {
+      const double *yn = &y_[n * kLanes];
+      for (std::size_t j = 0; j < kBinBlock; ++j)
+        for (std::size_t l = 0; l < kLanes; ++l)
+        {
+          const double s0 = yn[l] + c[j] * s1[j][l] - s2[j][l];
+          s2[j][l] = s1[j][l];
+          s1[j][l] = s0;
+        }
+    }
+    for (std::size_t j = 0; j < kBinBlock; ++j)
+      for (std::size_t l = 0; l < kLanes; ++l)
+        p[j][l] = s1[j][l] * s1[j][l] + s2[j][l] * s2[j][l] - c[j] * s1[j][l] * s2[j][l];
+  }
+
+  void alarms_update_(std::vector<std::array<BandStats, kAxes>> &out)
+  {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    for (std::size_t b = 0; b < out.size(); ++b)
+    {
+      const double limit = params_.bands[b].alarm_rms;
+      for (std::size_t a = 0; a < kAxes; ++a)
+      {
+        BandState &st = over_[b][a];
+        const BandStats &bs = out[b][a];
+        if (limit > 0.0 && bs.err_rms > limit)
+        {
+          if (++st.windows >= params_.alarm_hold && !st.alarm)
+          {
+            st.alarm = true;
+            alarms_.push({now, (uint16_t)a, (uint16_t)b, true, bs.err_rms, bs.peak_hz});
+          }
+        }
+        else
+        {
+          st.windows = 0;
+          if (st.alarm && !(bs.err_rms > 0.8 * limit))
+          {
+            st.alarm = false;
+            alarms_.push({now, (uint16_t)a, (uint16_t)b, false, bs.err_rms, bs.peak_hz});
+          }
+        }
+        out[b][a].alarm = st.alarm;
+      }
+    }
+  }
+
+  // Normal scheduling, niced: the analysis must never compete with the RT
+  // threads. On Linux setpriority(PRIO_PROCESS, 0) applies to this thread only.
+  void loop_()
+  {
+    setpriority(PRIO_PROCESS, 0, params_.nice);
+    while (run_.load())
+    {
+      service();
+      std::this_thread::sleep_for(params_.poll);
+    }
+  }
+
+  struct BandState
+  {
+    unsigned windows{0}; // consecutive windows over the limit
+    bool alarm{false};
+  };
+
+  const Tap &tap_;
+  Params params_;
+  std::size_t next_;         // next sample to read from tap_
+  uint32_t period_ns_{0};    // period of the samples in x_
+  std::size_t n_{0};         // samples in x_
+  std::vector<double> x_;    // [window][kLanes], oldest first
+  std::vector<double> y_;    // detrended and windowed copy of x_
+  std::vector<double> hann_;
+  double hann_sq_{0};
+  uint64_t lost_{0}, restarts_{0};
+  std::vector<std::array<BandState, kAxes>> over_;
+
+  mutable std::mutex m_;
+  Report report_;
+  SpscRing<Alarm, 64> alarms_;
+
+  std::atomic<bool> run_{false};
+  std::thread th_;
+};
@@ -0,0 +1,125 @@
+// TickProfiler.cpp
+#include "TickProfiler.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+  int perf_open(uint32_t type, uint64_t config, int group_fd)
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // pid 0 / cpu -1: the calling thread, on whatever CPU it runs
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  }
+}
+
+TickProfiler::TickProfiler()
+{
+#if defined(__aarch64__)
+  uint64_t freq;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  ns_per_tick_ = freq ? 1e9 / (double)freq : 1.0;
+#elif defined(__x86_64__) || defined(__i386__)
+  // calibrate the TSC against steady_clock over a short interval
+  const uint64_t c0 = now(), n0 = steadyNs_();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const uint64_t c1 = now(), n1 = steadyNs_();
+  ns_per_tick_ = (c1 > c0) ? (double)(n1 - n0) / (double)(c1 - c0) : 1.0;
+#endif
+}
+
+TickProfiler::~TickProfiler()
+{
+  for (int fd : perf_fd_)
+    if (fd >= 0)
+      ::close(fd);
+}
+
+uint64_t TickProfiler::steadyNs_()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool TickProfiler::attachPerf()
+{
+  if (perf_leader_.load() >= 0)
+    return true;
+  int leader = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1);
+  if (leader < 0)
+    return false;
+  perf_fd_[0] = leader;
+  perf_fd_[1] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+  perf_fd_[2] = perf_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, leader);
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  perf_leader_.store(leader);
+  return true;
+}
+
+void TickProfiler::snapshot_reset(Summary &out)
+{
+  for (std::size_t p = 0; p < kPhases; ++p)
+    for (std::size_t a = 0; a < kMaxAxes; ++a)
+    {
+      Acc &acc = acc_[p][a];
+      const uint64_t n = acc.n.exchange(0, std::memory_order_relaxed);
+      const uint64_t sum = acc.sum.exchange(0, std::memory_order_relaxed);
+      const uint64_t mx = acc.max.exchange(0, std::memory_order_relaxed);
+      Stat &s = out.s[p][a];
+      s.n = n;
+      s.avg_ns = n ? (double)sum * ns_per_tick_ / (double)n : 0.0;
+      s.max_ns = (double)mx * ns_per_tick_;
+    }
+
+  out.perf_valid = false;
+  const int leader = perf_leader_.load();
+  if (leader < 0)
+    return;
+  // PERF_FORMAT_GROUP: nr, then one value per opened member in open order
+  uint64_t buf[1 + 3] = {0, 0, 0, 0};
+  if (::read(leader, buf, sizeof(buf)) < (ssize_t)(2 * sizeof(uint64_t)))
+    return;
+  uint64_t vals[3] = {0, 0, 0};
+  for (uint64_t i = 0, k = 0; i < 3 && k < buf[0]; ++i)
+    if (perf_fd_[i] >= 0)
+      vals[i] = buf[1 + k++];
+  out.perf_valid = true;
+  out.instructions = vals[0] - perf_last_[0];
+  out.cache_misses = perf_fd_[1] >= 0 ? vals[1] - perf_last_[1] : 0;
+  out.context_switches = perf_fd_[2] >= 0 ? vals[2] - perf_last_[2] : 0;
+  std::memcpy(perf_last_, vals, sizeof(vals));
+}
+
+const char *TickProfiler::phaseName(Phase p)
+{
+  switch (p)
+  {
+  case Phase::Read:
+    return "read";
+  case Phase::Sample:
+    return "sample";
+  case Phase::Pid:
+    return "pid";
+  case Phase::Bus:
+    return "bus";
+  case Phase::Tick:
+    return "tick";
+  default:
+    return "?";
+  }
+}
@@ -0,0 +1,119 @@
+// TickProfiler.h
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Per-phase timing inside the control tick, per axis.
+//
+// Timestamps come from the CPU's free-running counter: cntvct_el0 on
+// aarch64 (the generic timer, 54 MHz on a Pi 4/5 => ~19 ns resolution),
+// the TSC on x86, steady_clock elsewhere. The control thread records with
+// relaxed atomics; housekeeping takes snapshot_reset() once per window.
+class TickProfiler
+{
+public:
+  enum class Phase : uint8_t
+  {
+    Read,   // encoder snapshot of all axes (axis 0)
+    Sample, // position update from the snapshot
+    Pid,    // PID::step
+    Bus,    // Motoron write
+    Tick,   // whole control tick (axis 0)
+    Count
+  };
+  static constexpr std::size_t kPhases = (std::size_t)Phase::Count;
+  static constexpr std::size_t kMaxAxes = 8;
+
+  struct Stat
+  {
+    uint64_t n{0};
+    double avg_ns{0.0};
+    double max_ns{0.0};
+  };
+  struct Summary
+  {
+    Stat s[kPhases][kMaxAxes];
+    // perf_event_open counters for the control thread (valid == false if unavailable)
+    bool perf_valid{false};
+    uint64_t instructions{0};
+    uint64_t cache_misses{0};
+    uint64_t context_switches{0};
+  };
+
+  TickProfiler();
+  ~TickProfiler();
+  TickProfiler(const TickProfiler &) = delete;
+  TickProfiler &operator=(const TickProfiler &) = delete;
+
+  static inline uint64_t now()
+  {
+#if defined(__aarch64__)
+    uint64_t v;
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r"(v)::"memory");
+    return v;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return steadyNs_();
+#endif
+  }
+
+  void record(Phase p, std::size_t axis, uint64_t ticks)
+  {
+    Acc &a = acc_[(std::size_t)p][axis < kMaxAxes ? axis : kMaxAxes - 1];
+    a.n.fetch_add(1, std::memory_order_relaxed);
+    a.sum.fetch_add(ticks, std::memory_order_relaxed);
+    uint64_t m = a.max.load(std::memory_order_relaxed);
+    while (ticks > m && !a.max.compare_exchange_weak(m, ticks, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  // RAII marker; a null profiler makes it a no-op
+  class Scope
+  {
+  public:
+    Scope(TickProfiler *p, Phase ph, std::size_t axis)
+        : p_(p), ph_(ph), axis_(axis), t0_(p ? now() : 0) {}
+    ~Scope()
+    {
+      if (p_)
+        p_->record(ph_, axis_, now() - t0_);
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    TickProfiler *p_;
+    Phase ph_;
+    std::size_t axis_;
+    uint64_t t0_;
+  };
+
+  // open instructions / cache-misses / context-switches counters for the
+  // calling thread; call from the control thread. false if perf is unavailable
+  // (e.g. kernel.perf_event_paranoid too strict).
+  bool attachPerf();
+
+  // housekeeping: take the window and start a new one
+  void snapshot_reset(Summary &out);
+
+  static const char *phaseName(Phase p);
+
+private:
+  static uint64_t steadyNs_();
+
+  struct Acc
+  {
+    std::atomic<uint64_t> n{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+  };
+  Acc acc_[kPhases][kMaxAxes];
+  double ns_per_tick_{1.0};
+
+  std::atomic<int> perf_leader_{-1};
+  int perf_fd_[3]{-1, -1, -1};
+  uint64_t perf_last_[3]{0, 0, 0};
+};
@@ -1,10 +1,13 @@
 #include "util.h"
-#include "Motoron.h"
-#include "Motor.h"
+#include "RobotConfig.h"
+#include "ControlLoop.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <csignal>
 #include <cmath>
@@ -21,78 +24,74 @@ int main()
               { running = false; });
 
   // --- Hardware init ---
-  Motoron motoron_1("/dev/i2c-1", 0x15);
-  motoron_1.initBasic();
-  // Motoron motoron_2("/dev/i2c-1", 0x16);
-  // motoron_2.initBasic();
-
-  // Build three motors; pass encoder lines (A,B)
-  Motor m1("/dev/gpiochip0", 5, 6, motoron_1, 1, 5);
-  m1.setCountsPerRev(4096);
-  m1.setGear(1.0);
-  m1.setPID(10, 40, 0.1);
-  m1.enable(true);
-
-  Motor m2("/dev/gpiochip0", 12, 13, motoron_1, 2, 5);
-  m2.setCountsPerRev(4096);
-  m2.setGear(1.0);
-  m2.setPID(10, 40, 0.1);
-  m2.enable(true);
-
-  Motor m3("/dev/gpiochip0", 16, 17, motoron_1, 3, 5);
-  m3.setCountsPerRev(4096);
-  m3.setGear(1.0);
-  m3.setPID(10, 40, 0.1);
-  m3.enable(true);
+  // Topology (pins, CPR, gear, driver/channel mapping, gains) lives in RobotConfig.h
+  RigRobot robot;
+  robot.enable(true);
 
   // initial setpoints
-  m1.setReference(0.0);
-  m2.setReference(0.0);
-  m3.setReference(0.0);
+  for (std::size_t i = 0; i < RigRobot::size(); ++i)
+    robot.axis(i).setReference(0.0);
 
-  // Periods
-  const auto period_ctrl = std::chrono::microseconds(1000); // 1 kHz
+  // Periods (control period comes from the overload manager: 1 kHz nominal)
   const auto period_kine = std::chrono::milliseconds(5);        // 200 Hz
 
   // Monitors
-  ThreadMonitor ctrl_monitor("control");
   ThreadMonitor kine_monitor("kinematics");
 
-  // --- 1 kHz control thread ---
-  std::thread control([&]
-                      {
-    try { set_realtime(80); } catch(...) {}
-    const double dt = 0.001;
-    while (running.load()) {
-      ctrl_monitor.begin_iter();
-
-      // Update each motor (encoder is interrupt-driven internally)
-      m1.update(dt);
-      m2.update(dt);
-      m3.update(dt);
+  // --- 1 kHz control thread (ControlLoop.h) ---
+  ControlLoop<RigRobot> control(robot);
+  ThreadMonitor &ctrl_monitor = control.monitor();
+  OverloadManager &overload = control.overload();
+  TickProfiler &profiler = control.profiler();
+  LatencyTrace &latency = control.trace();
+  // TRACE_JSON=file: keep the first 300k edge records (~100 s with three
+  // axes moving) and write them as a Chrome trace on exit
+  const char *trace_json = std::getenv("TRACE_JSON");
+  if (trace_json)
+    latency.setExport(300000);
+  // EVENT_CONTROL=1: tick on encoder movement (4 counts) or every 10 ms at
+  // rest instead of at a fixed 1 kHz
+  const bool event_mode = std::getenv("EVENT_CONTROL") != nullptr;
+  if (event_mode)
+    control.setEventMode({4, std::chrono::milliseconds(10)});
+  // IDLE_CONTROL=1: axes holding position stop writing the bus; with all of
+  // them idle the loop sleeps at 50 Hz until an encoder count or new reference
+  if (std::getenv("IDLE_CONTROL"))
+    control.setIdleMode({});
+  control.start();
 
-      ctrl_monitor.end_iter(period_ctrl);
-    }
-    motoron_1.coastAll(); });
+  // --- spectrum of tracking error / command (SpectralMonitor.h), niced ---
+  // ~1 s Hann windows at 1 kHz every 0.5 s; error RMS limits in revs
+  using Spectrum = SpectralMonitor<ControlLoop<RigRobot>::SampleTap>;
+  Spectrum::Params sp;
+  sp.bands = {{1.0, 10.0, 0.0}, {10.0, 40.0, 0.01}, {40.0, 150.0, 0.005}, {150.0, 490.0, 0.002}};
+  Spectrum spectrum(control.samples(), sp);
+  spectrum.start();
 
   // --- 200 Hz kinematics thread ---
   std::thread kine([&]
                    {
     try { set_realtime(60); } catch(...) {}
+    kine_monitor.tag_rt();
     double t = 0.0;
     while (running.load()) {
       kine_monitor.begin_iter();
 
       t += std::chrono::duration<double>(period_kine).count();
-      m1.setReference(25.0 * std::sin(2.0*3.1415926535*0.1*t));
+      robot.axis<0>().setReference(25.0 * std::sin(2.0*3.1415926535*0.1*t));
+      control.wake(); // event/idle mode: act on the new reference now
 
       kine_monitor.end_iter(period_kine);
-    } });
+    }
+    kine_monitor.untag_rt(); });
 
   // --- housekeeping: once per second, print thread stats ---
   std::thread hk([&]
                  {
     using namespace std::chrono;
+    std::array<Motoron::BusStats, RigRobot::kDrivers> bus_prev{};
+    ControlLoop<RigRobot>::EventStats ev_prev{};
+    ControlLoop<RigRobot>::IdleStats idle_prev{};
     while (running.load()) {
       std::this_thread::sleep_for(std::chrono::seconds(1));
 
@@ -111,18 +110,203 @@ int main()
       // Compute rough utilization as (iters * expected_workshare). Since we didn't retain busy_ns here,
       // report utilization as "N/A" and focus on misses/overruns. If you want exact %, we can extend the monitor.
       auto ns_to_us = [](int64_t ns){ return (double)ns/1000.0; };
+
+      // RT sentinels (RT_SENTINEL builds): any allocation, fault or
+      // context switch on the RT threads is reported with its call sites
+      if (rt_sentinel::kEnabled) {
+        for (ThreadMonitor *m : {&ctrl_monitor, &kine_monitor}) {
+          ThreadMonitor::RtStats rs;
+          m->rt_snapshot_reset(rs);
+          std::printf("[RT] %s: allocs=%llu, minflt=%llu, majflt=%llu, csw=%llu/%llu\n", m->name(),
+            (unsigned long long)rs.allocs, (unsigned long long)rs.minflt, (unsigned long long)rs.majflt,
+            (unsigned long long)rs.vcsw, (unsigned long long)rs.ivcsw);
+          for (uint32_t i = 0; i < rs.n_recent; ++i) {
+            char where[128];
+            rt_sentinel::describe(rs.recent[i].caller, where, sizeof(where));
+            std::printf("[RT]   %s(%zu) at %s\n", rt_sentinel::kindName(rs.recent[i].kind),
+                        rs.recent[i].bytes, where);
+          }
+        }
+        if (rt_sentinel::untaggedThreads())
+          std::printf("[RT] %llu thread(s) not monitored: out of sentinel records\n",
+                      (unsigned long long)rt_sentinel::untaggedThreads());
+        // encoder decode threads: tagged without a ThreadMonitor, allocations only
+        rt_sentinel::ThreadRecord *dec[rt_sentinel::kMaxThreads];
+        const int n_dec = rt_sentinel::unmonitoredThreads(dec, rt_sentinel::kMaxThreads);
+        for (int d = 0; d < n_dec; ++d) {
+          const char *name = dec[d]->name.load(std::memory_order_acquire);
+          const uint64_t a = dec[d]->allocs.exchange(0, std::memory_order_relaxed);
+          std::printf("[RT] %s: allocs=%llu\n", name ? name : "(exited)", (unsigned long long)a);
+          rt_sentinel::Violation v;
+          int shown = 0;
+          while (dec[d]->pop(v)) {
+            if (shown == 4)
+              continue; // first few call sites only
+            ++shown;
+            char where[128];
+            rt_sentinel::describe(v.caller, where, sizeof(where));
+            std::printf("[RT]   %s(%zu) at %s\n", rt_sentinel::kindName(v.kind), v.bytes, where);
+          }
+        }
+      }
+
+      // Rate transitions are always reported, with their timestamps
+      OverloadManager::Transition tr;
+      while (overload.popTransition(tr))
+        std::printf("[Overload] t=%.3fs control level %u -> %u, period %.0fus (misses=%u)\n",
+                    (double)tr.t_ns * 1e-9, (unsigned)tr.from, (unsigned)tr.to,
+                    ns_to_us(tr.period_ns), tr.misses);
+
+      // Spectral alarms are always reported, like rate transitions
+      Spectrum::Alarm sa;
+      while (spectrum.popAlarm(sa)) {
+        const SpectrumBand &bd = sp.bands[sa.band];
+        std::printf("[Spectrum] t=%.3fs axis %u %.0f-%.0fHz: %s, err_rms=%.5f, peak=%.1fHz\n",
+                    (double)sa.t_ns * 1e-9, (unsigned)sa.axis, bd.lo_hz, bd.hi_hz,
+                    sa.raised ? "ALARM" : "cleared", sa.err_rms, sa.peak_hz);
+      }
+
+      // Bus faults: printed for any board that retried, failed, reset or is
+      // not healthy in the last second (always, even when degraded)
+      for (std::size_t b = 0; b < RigRobot::kDrivers; ++b) {
+        const Motoron::BusStats bs = robot.driver(b).busStats();
+        const Motoron::BusStats &pv = bus_prev[b];
+        if (bs.retries != pv.retries || bs.failed != pv.failed || bs.skipped != pv.skipped ||
+            bs.resets != pv.resets || bs.crc_errors != pv.crc_errors ||
+            bs.board_crc_errors != pv.board_crc_errors || bs.health != Motoron::Health::Ok) {
+          static const char *const kHealth[] = {"ok", "failing", "recovering"};
+          std::printf("[Bus] board %zu: %s, writes=%llu, retries=%llu, failed=%llu, skipped=%llu, "
+                      "resets=%llu, recoveries=%llu/%llu, reopens=%llu, crc=%llu/%llu, errno=%d\n",
+            b, kHealth[(int)bs.health], (unsigned long long)(bs.writes - pv.writes),
+            (unsigned long long)(bs.retries - pv.retries), (unsigned long long)(bs.failed - pv.failed),
+            (unsigned long long)(bs.skipped - pv.skipped), (unsigned long long)bs.resets,
+            (unsigned long long)bs.reinits, (unsigned long long)bs.handovers,
+            (unsigned long long)bs.reopens, (unsigned long long)(bs.crc_errors - pv.crc_errors),
+            (unsigned long long)(bs.board_crc_errors - pv.board_crc_errors), bs.last_errno);
+        }
+        bus_prev[b] = bs;
+      }
+
+      TickProfiler::Summary ph;
+      profiler.snapshot_reset(ph);
+
+      // Degraded: keep only the thread counters, drop per-axis telemetry
+      // (the control loop itself stops tracing, phase timing and status polls)
+      if (overload.shedNonCritical()) {
+        std::printf("[Threads] control: iters=%llu, misses=%llu, worst_overrun=%.1fus, period=%.0fus (degraded)\n",
+          (unsigned long long)it_c, (unsigned long long)miss_c, ns_to_us(worst_c),
+          ns_to_us(overload.periodNs(overload.level())));
+        std::fflush(stdout);
+        continue;
+      }
+
       std::printf("[Threads] control: iters=%llu, misses=%llu, worst_overrun=%.1fus | "
                   "kinematics: iters=%llu, misses=%llu, worst_overrun=%.1fus | "
                   "pos=[%.4f, %.4f, %.4f], enc_illegal=[%u,%u,%u]\n",
         (unsigned long long)it_c, (unsigned long long)miss_c, ns_to_us(worst_c),
         (unsigned long long)it_k, (unsigned long long)miss_k, ns_to_us(worst_k),
-        m1.position(), m2.position(), m3.position(),
-        m1.encoderIllegal(), m2.encoderIllegal(), m3.encoderIllegal());
+        robot.axis(0).position(), robot.axis(1).position(), robot.axis(2).position(),
+        robot.axis(0).encoderIllegal(), robot.axis(1).encoderIllegal(), robot.axis(2).encoderIllegal());
+
+      // Debounce windows A/B in us ('!': held below the bounce by fast edges), dropped edges
+      AdaptiveDebounce::Stats db[RigRobot::size()][2];
+      for (std::size_t i = 0; i < RigRobot::size(); ++i)
+        for (int l = 0; l < 2; ++l)
+          robot.axis(i).encoder().debounceStats(l, db[i][l]);
+      std::printf("[Debounce] win_us=[");
+      for (std::size_t i = 0; i < RigRobot::size(); ++i)
+        std::printf("%s%.1f%s/%.1f%s", i ? " " : "", db[i][0].window_ns / 1000.0, db[i][0].limited ? "!" : "",
+          db[i][1].window_ns / 1000.0, db[i][1].limited ? "!" : "");
+      std::printf("] dropped=[");
+      for (std::size_t i = 0; i < RigRobot::size(); ++i)
+        std::printf("%s%llu/%llu", i ? " " : "", (unsigned long long)db[i][0].dropped,
+          (unsigned long long)db[i][1].dropped);
+      std::printf("]\n");
+
+      // Per-phase tick budget: avg/max per axis, in us
+      using Phase = TickProfiler::Phase;
+      const auto &tk = ph.s[(int)Phase::Tick][0];
+      const auto &rd = ph.s[(int)Phase::Read][0];
+      std::printf("[Phases] tick=%.1f/%.1fus | read=%.1f/%.1fus", tk.avg_ns / 1000.0, tk.max_ns / 1000.0,
+                  rd.avg_ns / 1000.0, rd.max_ns / 1000.0);
+      for (Phase p : {Phase::Sample, Phase::Pid, Phase::Bus}) {
+        std::printf(" | %s=[", TickProfiler::phaseName(p));
+        for (std::size_t i = 0; i < RigRobot::size(); ++i) {
+          const auto &st = ph.s[(int)p][i];
+          std::printf("%s%.1f/%.1f", i ? " " : "", st.avg_ns / 1000.0, st.max_ns / 1000.0);
+        }
+        std::printf("]");
+      }
+      if (ph.perf_valid)
+        std::printf(" | perf: instr=%llu, cache_miss=%llu, csw=%llu",
+          (unsigned long long)ph.instructions, (unsigned long long)ph.cache_misses,
+          (unsigned long long)ph.context_switches);
+      std::printf("\n");
+
+      // Event mode: why the control thread woke up in the last second
+      if (control.eventMode()) {
+        const auto ev = control.eventStats();
+        std::printf("[Event] ticks=%llu: edge=%llu, timeout=%llu, immediate=%llu, rate_limited=%llu\n",
+          (unsigned long long)it_c, (unsigned long long)(ev.edge_wakes - ev_prev.edge_wakes),
+          (unsigned long long)(ev.timeouts - ev_prev.timeouts),
+          (unsigned long long)(ev.immediate - ev_prev.immediate),
+          (unsigned long long)(ev.rate_limited - ev_prev.rate_limited));
+        ev_prev = ev;
+      }
+
+      // Idle mode: time per mode in the last second (ms), per-axis idle time
+      if (control.idleMode()) {
+        const auto id = control.idleStats();
+        std::printf("[Idle] active=%.0fms, idle=%.0fms, axes_idle=[",
+          (id.active_ns - idle_prev.active_ns) / 1e6, (id.idle_ns - idle_prev.idle_ns) / 1e6);
+        for (std::size_t i = 0; i < RigRobot::size(); ++i)
+          std::printf("%s%.0f", i ? " " : "", (id.axis_idle_ns[i] - idle_prev.axis_idle_ns[i]) / 1e6);
+        std::printf("], entries=%llu, wakes=%llu, writes_held=%llu\n",
+          (unsigned long long)(id.entries - idle_prev.entries), (unsigned long long)(id.wakes - idle_prev.wakes),
+          (unsigned long long)(id.writes_held - idle_prev.writes_held));
+        idle_prev = id;
+      }
+
+      // Edge-to-actuation latency per stage over consumed edges: p50/p99/max in us
+      LatencyTrace::Summary lt;
+      latency.snapshot_reset(lt);
+      std::printf("[Latency] edges=%llu, dropped=%llu", (unsigned long long)lt.s[(int)LatencyTrace::Stage::Total].n,
+                  (unsigned long long)lt.dropped);
+      for (std::size_t s = 0; s < LatencyTrace::kStages; ++s) {
+        const auto &ls = lt.s[s];
+        std::printf(" | %s=%.1f/%.1f/%.1f", LatencyTrace::stageName((LatencyTrace::Stage)s),
+                    ls.p50_us, ls.p99_us, ls.max_us);
+      }
+      std::printf("\n");
+
+      // Band RMS per axis of the last window: error in mrev, command in speed units
+      Spectrum::Report sr;
+      spectrum.snapshot(sr);
+      std::printf("[Spectrum] fs=%.0fHz, windows=%llu, lost=%llu, restarts=%llu",
+        sr.fs_hz, (unsigned long long)sr.windows, (unsigned long long)sr.lost,
+        (unsigned long long)sr.restarts);
+      for (std::size_t b = 0; b < sr.band.size(); ++b) {
+        std::printf(" | %.0f-%.0fHz err=[", sr.bands[b].lo_hz, sr.bands[b].hi_hz);
+        for (std::size_t i = 0; i < RigRobot::size(); ++i)
+          std::printf("%s%.2f%s", i ? " " : "", sr.band[b][i].err_rms * 1e3, sr.band[b][i].alarm ? "!" : "");
+        std::printf("] cmd=[");
+        for (std::size_t i = 0; i < RigRobot::size(); ++i)
+          std::printf("%s%.1f", i ? " " : "", sr.band[b][i].cmd_rms);
+        std::printf("]");
+      }
+      std::printf("\n");
       std::fflush(stdout);
     } });
 
-  control.join();
   kine.join();
   hk.join();
+  spectrum.stop();
+  control.stop(); // coasts all outputs
+  if (trace_json) {
+    if (latency.writeChromeTrace(trace_json))
+      std::printf("[Latency] trace written to %s\n", trace_json);
+    else
+      std::printf("[Latency] cannot write %s\n", trace_json);
+  }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+// rpimotor.cpp - C ABI over RigRobot + ControlLoop (see rpimotor.h)
+#include "rpimotor.h"
+#include "RobotConfig.h"
+#include "ControlLoop.h"
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct rpimotor
+{
+  RigRobot robot;
+  ControlLoop<RigRobot> loop{robot};
+  std::mutex mu; // one writer at a time: start / stop / enable / references
+};
+
+namespace
+{
+  thread_local std::string last_error;
+
+  int fail(const char *what)
+  {
+    last_error = what;
+    return -1;
+  }
+
+  // run f, turning C++ exceptions into -1 + last_error
+  template <typename F>
+  int guarded(F &&f)
+  {
+    try
+    {
+      return f();
+    }
+    catch (const std::exception &e)
+    {
+      return fail(e.what());
+    }
+    catch (...)
+    {
+      return fail("unknown error");
+    }
+  }
+
+  bool check_n(size_t n)
+  {
+    if (n == RigRobot::size())
+      return true;
+    char msg[96];
+    std::snprintf(msg, sizeof(msg), "expected %zu axes, got %zu", RigRobot::size(), n);
+    last_error = msg;
+    return false;
+  }
+}
+
+extern "C"
+{
+  uint32_t rpimotor_abi_version(void) { return RPIMOTOR_ABI_VERSION; }
+
+  const char *rpimotor_last_error(void) { return last_error.c_str(); }
+
+  rpimotor *rpimotor_create(void)
+  {
+    rpimotor *h = nullptr;
+    guarded([&]
+            { h = new rpimotor();
+              return 0; });
+    return h;
+  }
+
+  void rpimotor_destroy(rpimotor *h) { delete h; }
+
+  size_t rpimotor_axis_count(const rpimotor *) { return RigRobot::size(); }
+
+  int rpimotor_start(rpimotor *h)
+  {
+    if (!h)
+      return fail("null handle");
+    return guarded([&]
+                   { std::lock_guard<std::mutex> lk(h->mu);
+                     h->loop.start();
+                     return 0; });
+  }
+
+  int rpimotor_stop(rpimotor *h)
+  {
+    if (!h)
+      return fail("null handle");
+    return guarded([&]
+                   { std::lock_guard<std::mutex> lk(h->mu);
+                     h->loop.stop();
+                     return 0; });
+  }
+
+  int rpimotor_enable(rpimotor *h, int enable)
+  {
+    if (!h)
+      return fail("null handle");
+    return guarded([&]
+                   { std::lock_guard<std::mutex> lk(h->mu);
+                     h->loop.requestEnable(enable != 0);
+                     return 0; });
+  }
+
+  int rpimotor_set_references(rpimotor *h, const double *revs, size_t n)
+  {
+    if (!h || !revs)
+      return fail("null argument");
+    if (!check_n(n))
+      return -1;
+    std::array<double, RigRobot::size()> r;
+    for (size_t i = 0; i < n; ++i)
+      r[i] = revs[i];
+    std::lock_guard<std::mutex> lk(h->mu); // SeqLock: single writer
+    h->loop.setReferences(r);
+    return 0;
+  }
+
+  int rpimotor_read_state(rpimotor *h, double *t_s, uint64_t *tick,
+                          double *position, double *reference, double *command,
+                          size_t n)
+  {
+    if (!h)
+      return fail("null handle");
+    if (!check_n(n))
+      return -1;
+    const auto st = h->loop.state();
+    if (t_s)
+      *t_s = (double)st.t_ns * 1e-9;
+    if (tick)
+      *tick = st.tick;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (position)
+        position[i] = st.position[i];
+      if (reference)
+        reference[i] = st.reference[i];
+      if (command)
+        command[i] = st.command[i];
+    }
+    return 0;
+  }
+
+  int rpimotor_read_stats(rpimotor *h, rpimotor_stats *out)
+  {
+    if (!h || !out)
+      return fail("null argument");
+    double util;
+    h->loop.monitor().snapshot_reset(util, out->iters, out->misses, out->worst_overrun_ns);
+    out->rate_level = h->loop.overload().level();
+    out->period_ns = h->loop.overload().periodNs(h->loop.overload().level());
+    return 0;
+  }
+}
@@ -0,0 +1,68 @@
+/* rpimotor.h - stable C ABI over the C++ control core (librpimotor.so)
+ *
+ * The robot topology is the one compiled into the library (RobotConfig.h).
+ * All array arguments hold one element per axis, in RigConfig::axes order.
+ * Functions returning int give 0 on success and -1 on failure; the message
+ * is then available from rpimotor_last_error() on the same thread.
+ */
+#ifndef RPIMOTOR_H_
+#define RPIMOTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define RPIMOTOR_ABI_VERSION 1u
+
+/* the library is built with -fvisibility=hidden; only these are exported */
+#define RPIMOTOR_API __attribute__((visibility("default")))
+
+  typedef struct rpimotor rpimotor; /* opaque handle */
+
+  typedef struct
+  {
+    uint64_t iters;           /* control ticks in the last stats window */
+    uint64_t misses;          /* deadline misses in the window */
+    int64_t worst_overrun_ns; /* worst overrun in the window */
+    uint32_t rate_level;      /* 0 = full rate, >0 = degraded (OverloadManager) */
+    int64_t period_ns;        /* current control period */
+  } rpimotor_stats;
+
+  RPIMOTOR_API uint32_t rpimotor_abi_version(void);
+  RPIMOTOR_API const char *rpimotor_last_error(void);
+
+  /* opens GPIO and I2C, initializes the Motorons; outputs stay disabled */
+  RPIMOTOR_API rpimotor *rpimotor_create(void);
+  RPIMOTOR_API void rpimotor_destroy(rpimotor *h); /* stops the loops, coasts */
+
+  RPIMOTOR_API size_t rpimotor_axis_count(const rpimotor *h);
+
+  /* start / stop the RT control loop */
+  RPIMOTOR_API int rpimotor_start(rpimotor *h);
+  RPIMOTOR_API int rpimotor_stop(rpimotor *h);
+  /* applied by the control loop on its next tick (at once while stopped) */
+  RPIMOTOR_API int rpimotor_enable(rpimotor *h, int enable);
+
+  /* n must equal rpimotor_axis_count(); the batch is applied on one tick.
+   * start, stop, enable and set_references may be called from any thread;
+   * calls on one handle are serialized */
+  RPIMOTOR_API int rpimotor_set_references(rpimotor *h, const double *revs, size_t n);
+
+  /* state of one control tick; any output pointer may be NULL.
+   * t_s is the encoder snapshot time on CLOCK_MONOTONIC, in seconds. */
+  RPIMOTOR_API int rpimotor_read_state(rpimotor *h, double *t_s, uint64_t *tick,
+                                       double *position, double *reference, double *command,
+                                       size_t n);
+
+  /* takes the stats window and starts a new one */
+  RPIMOTOR_API int rpimotor_read_stats(rpimotor *h, rpimotor_stats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RPIMOTOR_H_ */
@@ -0,0 +1,16 @@
+// check.h - the CHECK macro shared by the offline tests
+#pragma once
+#include <cstdio>
+
+// failed checks so far; main() reports it and returns non-zero
+inline int failures = 0;
+
+#define CHECK(cond)                                                  \
+  do                                                                 \
+  {                                                                  \
+    if (!(cond))                                                     \
+    {                                                                \
+      std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);    \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
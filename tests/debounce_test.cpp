@@ -0,0 +1,149 @@
+// Offline check of the adaptive debounce: synthetic quadrature edges with
+// and without contact bounce, at slow and top speed. No GPIO hardware needed.
+#include "../AdaptiveDebounce.h"
+#include "check.h"
+#include <cstdio>
+
+// Two lines fed the way Encoder::worker_ does
+struct Lines
+{
+  AdaptiveDebounce d[2];
+  int64_t t{1000000};
+  uint64_t real_dropped{0}, bounce_passed{0};
+
+  Lines(uint32_t min_ns, uint32_t max_ns)
+  {
+    for (auto &x : d)
+      x.setRange(min_ns, max_ns);
+  }
+  bool edge(int line, int64_t at)
+  {
+    return d[line].onEdge(at, d[1 - line].lastEdge());
+  }
+  // 'steps' quadrature steps 'step_ns' apart, alternating A and B; every real
+  // edge is followed by 'bounces' extra edges 'bounce_ns' apart
+  void run(int steps, int64_t step_ns, int bounces, int64_t bounce_ns)
+  {
+    for (int k = 0; k < steps; ++k)
+    {
+      const int line = k & 1;
+      t += step_ns;
+      if (edge(line, t))
+        ++real_dropped;
+      for (int j = 1; j <= bounces; ++j)
+        if (!edge(line, t + j * bounce_ns))
+          ++bounce_passed;
+    }
+  }
+  void reset()
+  {
+    real_dropped = 0;
+    bounce_passed = 0;
+  }
+};
+
+static void test_buckets()
+{
+  CHECK(AdaptiveDebounce::bucket(10) == 0);
+  CHECK(AdaptiveDebounce::bucket(64) == 0);
+  CHECK(AdaptiveDebounce::bucket(96) == 1);
+  CHECK(AdaptiveDebounce::bucket(128) == 2);
+  CHECK(AdaptiveDebounce::bucket(~0ull) == AdaptiveDebounce::kBuckets - 1);
+  bool ok = true;
+  for (uint64_t ns = 64; ns < 100000000ull; ns = ns * 9 / 8 + 1)
+  {
+    const int b = AdaptiveDebounce::bucket(ns);
+    ok = ok && AdaptiveDebounce::bucketLow(b) <= ns && ns < AdaptiveDebounce::bucketLow(b + 1);
+  }
+  CHECK(ok);
+}
+
+// clean edges: nothing to filter, the window stays at the lower bound
+static void test_clean()
+{
+  Lines l(1000, 20000);
+  l.run(4000, 100000, 0, 0);
+  AdaptiveDebounce::Stats s;
+  l.d[0].stats(s);
+  CHECK(s.window_ns == 1000);
+  CHECK(s.dropped == 0 && s.bounce_p99_ns == 0);
+  CHECK(s.signal_p1_ns > 100000 && s.signal_p1_ns <= 200000);
+  CHECK(!s.limited);
+  CHECK(s.edges == 2000);
+}
+
+// 3 us bounce on a noisy cable: the window grows past it, only bounce is
+// dropped; once the cable is clean it returns to the lower bound
+static void test_bounce()
+{
+  Lines l(1000, 20000);
+  l.run(2000, 100000, 2, 3000); // adapt
+  l.reset();
+  l.run(4000, 100000, 2, 3000);
+  AdaptiveDebounce::Stats s;
+  l.d[1].stats(s);
+  CHECK(s.window_ns > 3000 && s.window_ns <= 6000);
+  CHECK(s.bounce_p99_ns > 3000);
+  CHECK(l.real_dropped == 0);
+  CHECK(l.bounce_passed == 0);
+
+  uint64_t bounce = 0;
+  for (int b = 0; b < AdaptiveDebounce::kBuckets; ++b)
+    bounce += s.bounce[b];
+  CHECK(bounce > 0);
+
+  l.run(8000, 100000, 0, 0);
+  l.d[1].stats(s);
+  CHECK(s.window_ns == 1000);
+}
+
+// top speed: steps so close that the bounce window would eat real edges;
+// the signal wins
+static void test_top_speed()
+{
+  Lines l(1000, 20000);
+  l.run(2000, 4000, 1, 3000);
+  l.reset();
+  l.run(4000, 4000, 1, 3000);
+  AdaptiveDebounce::Stats s;
+  l.d[0].stats(s);
+  CHECK(s.limited);
+  CHECK(s.window_ns <= s.signal_p1_ns / 2);
+  CHECK(l.real_dropped == 0);
+}
+
+// bounce longer than the upper bound: clamped, the long repeats are not bounce
+static void test_bounds()
+{
+  Lines l(2000, 5000);
+  l.run(4000, 200000, 1, 30000);
+  AdaptiveDebounce::Stats s;
+  l.d[0].stats(s);
+  CHECK(s.window_ns == 2000);
+
+  Lines f(5000, 5000); // fixed
+  f.run(4000, 100000, 2, 3000);
+  f.d[0].stats(s);
+  CHECK(s.window_ns == 5000);
+  CHECK(f.real_dropped == 0 && f.bounce_passed == 0);
+
+  Lines off(0, 0); // no debounce at all
+  off.run(1000, 100000, 2, 300);
+  CHECK(off.bounce_passed == 1000 * 2);
+}
+
+int main()
+{
+  test_buckets();
+  test_clean();
+  test_bounce();
+  test_top_speed();
+  test_bounds();
+  if (failures)
+  {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("debounce_test: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,115 @@
+// fake_gpiod.cpp - see fake_gpiod.h
+#include "fake_gpiod.h"
+#include <gpiod.h>
+#include <atomic>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct gpiod_chip
+{
+  int unused;
+};
+
+struct gpiod_line
+{
+  unsigned offset;
+  int rfd{-1}, wfd{-1};
+  std::atomic<int> queued{0};
+};
+
+namespace
+{
+  constexpr int kLines = 32;
+  constexpr int kFifo = 16; // GPIO v1 uAPI line event FIFO
+
+  gpiod_chip chip;
+  gpiod_line lines[kLines];
+  std::atomic<uint32_t> levels{0};
+  std::atomic<uint64_t> dropped{0};
+}
+
+void fake_gpiod_set(unsigned offset, int level)
+{
+  const uint32_t bit = 1u << offset;
+  const uint32_t old = levels.load();
+  const uint32_t neu = level ? (old | bit) : (old & ~bit);
+  if (neu == old)
+    return;
+  levels.store(neu);
+
+  gpiod_line &l = lines[offset];
+  if (l.wfd < 0)
+    return;
+  if (l.queued.load() >= kFifo)
+  {
+    dropped.fetch_add(1);
+    return;
+  }
+  gpiod_line_event ev{};
+  clock_gettime(CLOCK_MONOTONIC, &ev.ts);
+  ev.event_type = level ? 1 : 2; // rising, falling
+  l.queued.fetch_add(1);
+  if (::write(l.wfd, &ev, sizeof(ev)) != (ssize_t)sizeof(ev))
+    l.queued.fetch_sub(1);
+}
+
+uint32_t fake_gpiod_levels() { return levels.load(); }
+uint64_t fake_gpiod_dropped() { return dropped.load(); }
+
+gpiod_chip *gpiod_chip_open(const char *) { return &chip; }
+void gpiod_chip_close(gpiod_chip *) {}
+
+gpiod_line *gpiod_chip_get_line(gpiod_chip *, unsigned offset)
+{
+  if (offset >= (unsigned)kLines)
+  {
+    errno = EINVAL;
+    return nullptr;
+  }
+  lines[offset].offset = offset;
+  return &lines[offset];
+}
+
+gpiod_chip *gpiod_line_get_chip(gpiod_line *) { return &chip; }
+
+int gpiod_line_request_both_edges_events_flags(gpiod_line *line, const char *, int)
+{
+  int p[2];
+  if (pipe2(p, O_NONBLOCK | O_CLOEXEC) < 0)
+    return -1;
+  line->rfd = p[0];
+  line->wfd = p[1];
+  line->queued.store(0);
+  return 0;
+}
+
+void gpiod_line_release(gpiod_line *line)
+{
+  if (line->rfd >= 0)
+    ::close(line->rfd);
+  if (line->wfd >= 0)
+    ::close(line->wfd);
+  line->rfd = line->wfd = -1;
+}
+
+int gpiod_line_get_value(gpiod_line *line) { return (int)((levels.load() >> line->offset) & 1u); }
+
+int gpiod_line_get_value_bulk(gpiod_line_bulk *bulk, int *values)
+{
+  const uint32_t lv = levels.load();
+  for (unsigned i = 0; i < bulk->num_lines; ++i)
+    values[i] = (int)((lv >> bulk->lines[i]->offset) & 1u);
+  return 0;
+}
+
+int gpiod_line_event_get_fd(gpiod_line *line) { return line->rfd; }
+
+int gpiod_line_event_read(gpiod_line *line, gpiod_line_event *event)
+{
+  if (::read(line->rfd, event, sizeof(*event)) != (ssize_t)sizeof(*event))
+    return -1;
+  line->queued.fetch_sub(1);
+  return 0;
+}
@@ -0,0 +1,12 @@
+// Software stand-in for the libgpiod v1 calls Encoder and EncoderSampler
+// make, so both can run offline. One chip with 32 lines; each line requested
+// for events gets a pipe as its event fd, with the kernel's 16-event FIFO.
+#pragma once
+#include <cstdint>
+
+// set line 'offset' to 'level'; a change queues an edge event stamped now
+void fake_gpiod_set(unsigned offset, int level);
+// bit n = level of line n, like GpioMemSource
+uint32_t fake_gpiod_levels();
+// events dropped because a line's FIFO was full
+uint64_t fake_gpiod_dropped();
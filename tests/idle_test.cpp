@@ -0,0 +1,78 @@
+// Offline check of ControlLoop's idle mode: one axis on fake GPIO lines and
+// an emulated Motoron, at rest with a small residual error inside the idle
+// tolerance. The integrator must not pull it out of idle.
+#include "../Robot.h"
+#include "../ControlLoop.h"
+#include "../MotoronEmulator.h"
+#include "check.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+struct IdleTestConfig
+{
+  static constexpr const char *chip = "/dev/gpiochip0";
+
+  static constexpr std::array<DriverConfig, 1> drivers{{
+      {"emulator", 0x10},
+  }};
+
+  // a strong integrator: on 0.0003 rev it moves the command every ~10 ms
+  static constexpr std::array<AxisConfig, 1> axes{{
+      {5, 6, 4096.0, 1.0, 0, 1, 10.0, 400.0, 0.0, 1},
+  }};
+
+  static constexpr SamplerConfig sampler{false, false, -1, 0, 0.0, 0.0};
+  static constexpr BusConfig bus{200, 8, 0};
+};
+
+using IdleRobot = Robot<IdleTestConfig>;
+using Loop = ControlLoop<IdleRobot>;
+
+static void test_residual_error_stays_idle()
+{
+  MotoronEmulator emu;
+  std::array<std::unique_ptr<MotoronTransport>, 1> t{{std::make_unique<EmulatorTransport>(emu)}};
+  IdleRobot robot(std::move(t));
+  robot.enable(true);
+  robot.axis(0).setReference(0.0003); // encoder stays at 0: error within pos_tol_rev
+
+  Loop control(robot);
+  Loop::IdleMode im;
+  im.settle = std::chrono::milliseconds(50);
+  control.setIdleMode(im);
+  control.start();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(400));
+  const Loop::IdleStats s1 = control.idleStats();
+  const Loop::State c1 = control.state();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  const Loop::IdleStats s2 = control.idleStats();
+  const Loop::State c2 = control.state();
+
+  // idle once and for good; the held command is what the board has
+  CHECK(s2.entries == 1);
+  CHECK(s2.axis_idle_ns[0] - s1.axis_idle_ns[0] >= 250000000ull);
+  CHECK(c2.command[0] == c1.command[0]);
+  CHECK(emu.targetSpeed(1) == (int16_t)c2.command[0]);
+  CHECK(s2.writes_held > 0);
+
+  // a new reference wakes it and the PID runs again
+  control.setReferences({0.01});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const Loop::State c3 = control.state();
+  CHECK(c3.reference[0] == 0.01);
+  CHECK(c3.command[0] > c2.command[0]);
+  CHECK(emu.targetSpeed(1) == (int16_t)c3.command[0]);
+
+  control.stop();
+}
+
+int main()
+{
+  test_residual_error_stays_idle();
+  std::printf(failures ? "idle_test: %d FAILED\n" : "idle_test: OK\n", failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,546 @@
+// Offline check of the Motoron command layer against the software emulator
+// (MotoronEmulator.h): frame encoding vs golden frames produced by the
+// reference motoron.py, emulated board behaviour, error paths, and the
+// achievable command rate over the in-process transport.
+// ./motoron_emulator_test pty  also runs the serial path over a pty.
+#include "../Motoron.h"
+#include "../MotoronEmulator.h"
+#include "../BusSupervisor.h"
+#include "check.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+// Records frames instead of sending them
+struct CaptureTransport : MotoronTransport
+{
+  std::vector<Bytes> frames;
+  int tryWrite(const uint8_t *d, size_t n) noexcept override
+  {
+    frames.emplace_back(d, d + n);
+    return 0;
+  }
+  int tryRead(uint8_t *, size_t) noexcept override { return EIO; }
+};
+
+static void send(MotoronEmulator &emu, const Bytes &b)
+{
+  emu.receive(b.data(), b.size());
+  emu.endTransaction();
+}
+
+static Bytes drain(MotoronEmulator &emu)
+{
+  uint8_t buf[256];
+  size_t n = emu.respond(buf, sizeof(buf));
+  return Bytes(buf, buf + n);
+}
+
+// Golden frames: motoron.py (MotoronI2C / MotoronSerial), CRC enabled
+// unless noted. The last byte of each CRC'd frame is the reference CRC.
+static const std::vector<Bytes> kGolden = {
+    {0x8B, 0x04, 0x7B, 0x43},                         // set_protocol_options(0x04)
+    {0x8B, 0x07, 0x78, 0x2F},                         // set_protocol_options(0x07)
+    {0xD1, 0x01, 0x54, 0x7D, 0x6B},                   // set_speed(1, -300)
+    {0xD2, 0x02, 0x20, 0x06, 0x09},                   // set_speed_now(2, 800)
+    {0xD4, 0x03, 0x7B, 0x00, 0x6E},                   // set_buffered_speed(3, 123)
+    {0xE1, 0x64, 0x00, 0x38, 0x7E, 0x2C, 0x02, 0x60}, // set_all_speeds(100, -200, 300)
+    {0xE2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x51}, // set_all_speeds_now(0, 0, 0)
+    {0xF0, 0x77},                                     // set_all_speeds_using_buffers
+    {0xA9, 0x00, 0x04, 0x06},                         // clear_reset_flag
+    {0x9C, 0x00, 0x05, 0x19, 0x00, 0x2A},             // set_command_timeout_milliseconds(100)
+    {0x9C, 0x01, 0x0A, 0x32, 0x00, 0x75},             // set_max_acceleration_forward(1, 50)
+    {0xF5, 0x10},                                     // reset_command_timeout
+    {0xA5, 0x3D},                                     // coast_now
+    {0x9A, 0x00, 0x01, 0x02, 0x55},                   // get_variables(0, 1, 2)
+    {0xAA, 0x11, 0x51, 0x02, 0x10, 0x03, 0x04},       // serial dev 17: set_speed(2, 400)
+    {0xFA, 0x10, 0x02, 0x03, 0x51, 0x01, 0x64, 0x00, 0x01, 0x1C, 0x7F, 0x1C},
+    // serial: multi_device_write(16, 2, SET_SPEED, [1,100,0, 1,-100])
+    {0xF9, 0x10, 0x02, 0x28}, // serial: multi_device_error_check_start(16, 2)
+};
+
+static void test_crc_matches_reference()
+{
+  for (const Bytes &f : kGolden)
+  {
+    CHECK(Motoron::crc(f.data(), f.size() - 1) == f.back());
+    CHECK(motoron_protocol::crcBitwise(f.data(), f.size() - 1) == f.back());
+  }
+  // table against the bitwise definition on every prefix of a pseudo-random run
+  uint8_t buf[64];
+  uint32_t x = 12345;
+  for (uint8_t &b : buf)
+  {
+    x = x * 1103515245u + 12345u;
+    b = (uint8_t)(x >> 16);
+  }
+  bool same = true;
+  for (size_t n = 0; n <= sizeof(buf); ++n)
+    same = same && motoron_protocol::crc(buf, n) == motoron_protocol::crcBitwise(buf, n);
+  CHECK(same);
+}
+
+// Motoron.cpp frames, byte for byte, against motoron.py
+static void test_driver_frames()
+{
+  auto cap = std::make_unique<CaptureTransport>();
+  CaptureTransport *c = cap.get();
+  Motoron m(std::move(cap));
+  m.setSpeed(1, 100); // ignored: not enabled yet
+  CHECK(c->frames.empty());
+  m.initBasic();
+  CHECK(c->frames.size() == 2);
+  CHECK(c->frames[0] == kGolden[1]); // CRC for commands and responses
+  CHECK(c->frames[1] == kGolden[8]); // clear_reset_flag
+  m.setSpeed(2, 800);
+  CHECK(c->frames.back() == kGolden[3]);
+  m.setSpeed(1, -5000); // clamped
+  CHECK(c->frames.back() == Bytes({0xD2, 0x01, 0x60, 0x79, 0x58}));
+  m.coastAll();
+  CHECK(c->frames.back() == kGolden[6]);
+
+  // CRC off on request
+  m.setCrc(false);
+  m.initBasic();
+  CHECK(c->frames[c->frames.size() - 2] == kGolden[0]); // CRC sent even though it turns CRC off
+  CHECK(c->frames.back() == Bytes({0xA9, 0x00, 0x04}));
+  m.setSpeed(2, 800);
+  CHECK(c->frames.back() == Bytes(kGolden[3].begin(), kGolden[3].end() - 1));
+  m.coastAll();
+  CHECK(c->frames.back() == Bytes(kGolden[6].begin(), kGolden[6].end() - 1));
+}
+
+static void test_init_and_speeds()
+{
+  MotoronEmulator emu;
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_RESET));
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_ERROR_ACTIVE));
+  CHECK(emu.protocolOptions() == 0x07);
+
+  auto t = std::make_unique<EmulatorTransport>(emu);
+  Motoron m(std::move(t));
+  m.initBasic();
+  CHECK(emu.protocolOptions() == 0x07);
+  CHECK(!(emu.statusFlags() & (1 << STATUS_FLAG_RESET)));
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_MOTOR_OUTPUT_ENABLED));
+
+  m.setSpeed(1, -300);
+  m.setSpeed(3, 800);
+  CHECK(emu.currentSpeed(1) == -300 && emu.targetSpeed(1) == -300);
+  CHECK(emu.currentSpeed(3) == 800);
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_MOTOR_DRIVING));
+  m.coastAll();
+  CHECK(emu.currentSpeed(1) == 0 && emu.currentSpeed(3) == 0);
+  CHECK(emu.counters().protocol_errors == 0 && emu.counters().crc_errors == 0);
+}
+
+static void test_crc_and_protocol_errors()
+{
+  MotoronEmulator emu; // CRC on by default
+  Bytes bad = kGolden[2];
+  bad.back() ^= 0x01;
+  send(emu, bad);
+  CHECK(emu.counters().crc_errors == 1);
+  CHECK(emu.targetSpeed(1) == 0);
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_CRC_ERROR));
+
+  send(emu, kGolden[2]);
+  CHECK(emu.targetSpeed(1) == -300);
+
+  // missing CRC: the I2C transaction ends mid-frame
+  send(emu, Bytes({0xD1, 0x01, 0x10, 0x00}));
+  CHECK(emu.counters().protocol_errors == 1);
+  CHECK(emu.targetSpeed(1) == -300);
+
+  // unknown command, bad motor, bad option complement, stray data byte
+  send(emu, Bytes({0x80}));
+  Bytes m4 = {0xD1, 0x04, 0x00, 0x00};
+  m4.push_back(Motoron::crc(m4.data(), m4.size()));
+  send(emu, m4);
+  Bytes opt = {0x8B, 0x04, 0x00};
+  opt.push_back(Motoron::crc(opt.data(), opt.size()));
+  send(emu, opt);
+  send(emu, Bytes({0x12}));
+  CHECK(emu.counters().protocol_errors == 5);
+  CHECK(emu.protocolOptions() == 0x07);
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_PROTOCOL_ERROR));
+
+  // CRC off: plain frames, and reset/options still take an optional CRC
+  send(emu, kGolden[0]);
+  CHECK(emu.protocolOptions() == 0x04);
+  send(emu, Bytes({0xD1, 0x01, 0x54, 0x7D}));
+  CHECK(emu.targetSpeed(1) == -300);
+  send(emu, Bytes({0x8B, 0x04, 0x7B}));
+  CHECK(emu.protocolOptions() == 0x04);
+  const auto before = emu.counters();
+  send(emu, Bytes({0x99, 0x00})); // reset + bad CRC
+  CHECK(emu.counters().crc_errors == before.crc_errors + 1);
+  CHECK(emu.protocolOptions() == 0x04);
+  send(emu, Bytes({0x99}));
+  CHECK(emu.protocolOptions() == 0x07);
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_RESET));
+}
+
+static void test_variables_and_responses()
+{
+  MotoronEmulator emu;
+  send(emu, kGolden[8]);  // clear reset flag
+  send(emu, kGolden[9]);  // timeout 100 ms
+  CHECK(emu.commandTimeout() == 25);
+  send(emu, kGolden[13]); // get status flags, with response CRC
+  Bytes r = drain(emu);
+  CHECK(r.size() == 3);
+  if (r.size() == 3)
+  {
+    CHECK(Motoron::crc(r.data(), 2) == r[2]);
+    const uint16_t f = r[0] | (r[1] << 8);
+    CHECK(f == emu.statusFlags());
+    CHECK(!(f & (1 << STATUS_FLAG_RESET)));
+  }
+
+  Bytes fw = {CMD_GET_FIRMWARE_VERSION};
+  fw.push_back(Motoron::crc(fw.data(), 1));
+  send(emu, fw);
+  r = drain(emu);
+  CHECK(r.size() == 5 && r[0] == 0xCC && r[1] == 0x00);
+
+  // motor variables: max accel forward, read back as u16
+  send(emu, kGolden[10]);
+  Bytes gv = {0x9A, 0x01, 0x0A, 0x02};
+  gv.push_back(Motoron::crc(gv.data(), gv.size()));
+  send(emu, gv);
+  r = drain(emu);
+  CHECK(r.size() == 3 && r[0] == 50 && r[1] == 0);
+
+  // responses without CRC
+  send(emu, kGolden[0]);
+  send(emu, Bytes({0x9A, 0x00, 0x00, 0x01}));
+  r = drain(emu);
+  CHECK(r.size() == 1 && r[0] == 0x04);
+}
+
+static void test_timeout_and_buffers()
+{
+  MotoronEmulator emu;
+  send(emu, kGolden[8]);
+  send(emu, kGolden[9]); // 100 ms
+  send(emu, kGolden[4]); // buffered 3 = 123
+  CHECK(emu.bufferedSpeed(3) == 123 && emu.targetSpeed(3) == 0);
+  send(emu, kGolden[7]);
+  CHECK(emu.targetSpeed(3) == 123);
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(3) == 123);
+
+  emu.tick(0.085);
+  CHECK(!(emu.statusFlags() & (1 << STATUS_FLAG_COMMAND_TIMEOUT)));
+  send(emu, kGolden[11]); // keepalive
+  emu.tick(0.095);
+  CHECK(emu.currentSpeed(3) == 123);
+  emu.tick(0.010);
+  const uint16_t f = emu.statusFlags();
+  CHECK(f & (1 << STATUS_FLAG_COMMAND_TIMEOUT));
+  CHECK(f & (1 << STATUS_FLAG_COMMAND_TIMEOUT_LATCHED));
+  CHECK(f & (1 << STATUS_FLAG_ERROR_ACTIVE));
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(3) == 0); // error response: coast
+  CHECK(emu.counters().timeouts == 1);
+
+  // keepalive clears the live flag but not the latched one
+  send(emu, kGolden[11]);
+  CHECK(!(emu.statusFlags() & (1 << STATUS_FLAG_COMMAND_TIMEOUT)));
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_COMMAND_TIMEOUT_LATCHED));
+}
+
+static void test_acceleration()
+{
+  MotoronEmulator emu;
+  send(emu, kGolden[8]);
+  send(emu, kGolden[10]); // motor 1: +50 per 10 ms forward
+  Bytes dec = {0x9C, 0x01, 14, 100, 0};
+  dec.push_back(Motoron::crc(dec.data(), dec.size()));
+  send(emu, dec); // decel forward 100 per 10 ms
+  Bytes sp = {0xD1, 0x01, 200 & 0x7F, 200 >> 7};
+  sp.push_back(Motoron::crc(sp.data(), sp.size()));
+  send(emu, sp);
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(1) == 50);
+  emu.tick(0.025); // two more steps, 5 ms carried
+  CHECK(emu.currentSpeed(1) == 150);
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(1) == 200);
+  send(emu, kGolden[2]); // -300: decel to 0, then reverse (unlimited)
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(1) == 100);
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(1) == 0);
+  emu.tick(0.010);
+  CHECK(emu.currentSpeed(1) == -300);
+}
+
+static void test_serial_framing()
+{
+  MotoronEmulator a(MotoronEmulator::Bus::Serial, 16), b(MotoronEmulator::Bus::Serial, 17);
+  for (MotoronEmulator *e : {&a, &b})
+  {
+    Bytes clr = {0xA9, 0x00, 0x04};
+    clr.push_back(Motoron::crc(clr.data(), clr.size()));
+    e->receive(clr.data(), clr.size());
+    e->receive(kGolden[14].data(), kGolden[14].size()); // Pololu, device 17
+    e->receive(kGolden[15].data(), kGolden[15].size()); // multi-device write
+  }
+  CHECK(a.targetSpeed(2) == 0 && b.targetSpeed(2) == 400);
+  CHECK(a.targetSpeed(1) == 100 && b.targetSpeed(1) == -100);
+
+  for (MotoronEmulator *e : {&a, &b})
+    e->receive(kGolden[16].data(), kGolden[16].size());
+  CHECK(drain(a) == Bytes({0x3C}));
+  CHECK(drain(b) == Bytes({0x3C}));
+
+  // serial frames may arrive split across reads
+  const Bytes &g = kGolden[2];
+  a.receive(g.data(), 2);
+  a.receive(g.data() + 2, g.size() - 2);
+  CHECK(a.targetSpeed(1) == -300);
+  CHECK(a.counters().protocol_errors == 0 && b.counters().protocol_errors == 0);
+
+  // multi-device commands are serial-only
+  MotoronEmulator i2c;
+  send(i2c, kGolden[16]);
+  CHECK(i2c.counters().protocol_errors == 1);
+}
+
+static void test_fault_injection()
+{
+  MotoronEmulator emu;
+  auto t = std::make_unique<EmulatorTransport>(emu);
+  EmulatorTransport *tp = t.get();
+  Motoron m(std::move(t));
+  m.initBasic();
+  tp->failNextWrites(2);
+  bool threw = false;
+  try
+  {
+    m.setSpeed(1, 100);
+  }
+  catch (const std::runtime_error &)
+  {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK(emu.targetSpeed(1) == 0);
+  try
+  {
+    m.setSpeed(1, 100);
+  }
+  catch (const std::runtime_error &)
+  {
+  }
+  m.setSpeed(1, 100);
+  CHECK(emu.targetSpeed(1) == 100);
+  CHECK(tp->failedWrites() == 2);
+}
+
+// Control-path writes: time-bounded retries, handover after repeated
+// failures, recovery off-thread, and re-init when the reset flag shows up
+static void test_bus_recovery()
+{
+  MotoronEmulator emu;
+  auto t = std::make_unique<EmulatorTransport>(emu);
+  EmulatorTransport *tp = t.get();
+  Motoron m(std::move(t));
+  m.initBasic();
+  m.setFailLimit(3);
+
+  // a NACK burst inside the budget is absorbed by retries
+  tp->failNextWrites(2);
+  CHECK(m.trySetSpeed(1, 100, Motoron::nowNs() + 5000000));
+  CHECK(emu.targetSpeed(1) == 100);
+  CHECK(m.busStats().retries == 2 && m.busStats().failed == 0);
+
+  // a board that keeps NACKing is retried until the deadline, then given up
+  tp->failNextWrites(1000000);
+  const uint64_t r0 = m.busStats().retries;
+  const int64_t t0 = Motoron::nowNs();
+  CHECK(!m.trySetSpeed(1, 150, t0 + 2000000));
+  const int64_t spent = Motoron::nowNs() - t0;
+  CHECK(spent >= 2000000 && spent < 50000000);
+  CHECK(m.busStats().retries > r0 && m.busStats().failed == 1);
+  CHECK(m.busStats().retries - r0 <= 2000000 / Motoron::kRetryGapNs);
+  tp->failNextWrites(0);
+  CHECK(m.trySetSpeed(1, 100));
+  CHECK(m.health() == Motoron::Health::Ok);
+
+  // no budget: one attempt, then Failing, then Recovering
+  tp->failNextWrites(1000);
+  CHECK(!m.trySetSpeed(1, 200));
+  CHECK(m.health() == Motoron::Health::Failing);
+  CHECK(!m.trySetSpeed(1, 200));
+  CHECK(!m.trySetSpeed(1, 200));
+  CHECK(m.health() == Motoron::Health::Recovering);
+  const uint64_t failed = tp->failedWrites();
+  CHECK(!m.trySetSpeed(1, 200)); // skipped, bus untouched
+  CHECK(tp->failedWrites() == failed);
+  CHECK(m.busStats().skipped == 1 && m.busStats().failed == 4);
+
+  BusSupervisor::Params sp;
+  sp.min_backoff = std::chrono::milliseconds(0);
+  BusSupervisor sup(sp);
+  sup.attach(m);
+  CHECK(sup.service() == 1); // still NACKing
+  tp->failNextWrites(0);
+  CHECK(sup.service() == 0);
+  CHECK(m.health() == Motoron::Health::Ok);
+  CHECK(tp->reopens() == 2 && m.busStats().reinits == 1);
+  CHECK(m.trySetSpeed(1, 300));
+  CHECK(emu.targetSpeed(1) == 300);
+
+  // reset flag seen by a status poll: re-init without a reopen
+  Bytes set_reset = {CMD_SET_LATCHED_STATUS_FLAGS, 0x00, 0x04};
+  set_reset.push_back(Motoron::crc(set_reset.data(), set_reset.size()));
+  send(emu, set_reset);
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus());
+  CHECK(m.lastStatus() & (1 << STATUS_FLAG_RESET));
+  CHECK(m.health() == Motoron::Health::Recovering && m.busStats().resets == 1);
+  CHECK(sup.service() == 0);
+  CHECK(tp->reopens() == 2 && m.busStats().reinits == 2);
+  CHECK(!(emu.statusFlags() & (1 << STATUS_FLAG_RESET)));
+
+  // real reset: the board is back at its defaults with the reset flag set;
+  // the poll sees it and initBasic() brings the board back
+  emu.powerCycle();
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus());
+  CHECK(m.health() == Motoron::Health::Recovering && m.busStats().resets == 2);
+  CHECK(sup.service() == 0);
+  CHECK(emu.protocolOptions() == 0x07);
+  CHECK(m.trySetSpeed(2, -50));
+  CHECK(emu.targetSpeed(2) == -50);
+}
+
+// Response CRC: corrupted polls are counted per board and treated like
+// unanswered ones; commands the board rejected show up via its CRC flag
+static void test_crc_responses()
+{
+  MotoronEmulator emu;
+  auto t = std::make_unique<EmulatorTransport>(emu);
+  EmulatorTransport *tp = t.get();
+  Motoron m(std::move(t));
+  m.initBasic();
+
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus());
+  CHECK(m.busStats().crc_errors == 0 && m.busStats().polls == 1);
+
+  tp->corruptNextReads(1);
+  const uint16_t last = m.lastStatus();
+  CHECK(m.requestStatus());
+  CHECK(!m.collectStatus());
+  CHECK(m.busStats().crc_errors == 1 && m.lastStatus() == last);
+  CHECK(m.busStats().last_errno == EBADMSG);
+  CHECK(m.health() == Motoron::Health::Failing);
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus()); // clean again
+  CHECK(m.busStats().polls == 2);
+
+  // two corrupted in a row: recovery, whose read is checked too
+  tp->corruptNextReads(3);
+  for (int i = 0; i < 2; ++i)
+  {
+    m.requestStatus();
+    m.collectStatus();
+  }
+  CHECK(m.health() == Motoron::Health::Recovering);
+  CHECK(!m.recover());
+  CHECK(m.busStats().crc_errors == 4);
+  CHECK(m.recover());
+  CHECK(m.health() == Motoron::Health::Ok);
+
+  // a command hit by noise on the way to the board
+  Bytes bad = {0xD2, 0x01, 0x10, 0x00, 0x00};
+  bad.back() = (uint8_t)(Motoron::crc(bad.data(), 4) ^ 0x01);
+  send(emu, bad);
+  CHECK(emu.targetSpeed(1) == 0);
+  CHECK(emu.statusFlags() & (1 << STATUS_FLAG_CRC_ERROR));
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus());
+  CHECK(m.busStats().board_crc_errors == 1);
+  CHECK(!(emu.statusFlags() & (1 << STATUS_FLAG_CRC_ERROR))); // cleared for the next one
+  CHECK(m.requestStatus());
+  CHECK(m.collectStatus());
+  CHECK(m.busStats().board_crc_errors == 1);
+  CHECK(emu.counters().crc_errors == 1);
+}
+
+// Commands/s through Motoron -> transport -> emulator parser. An upper bound
+// for the host side; a 400 kHz I2C bus carries ~9k four-byte writes/s.
+static void bench_command_rate()
+{
+  MotoronEmulator emu;
+  Motoron m(std::make_unique<EmulatorTransport>(emu));
+  m.initBasic();
+  const int n = 200000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    m.setSpeed(1 + (i % 3), (int16_t)((i % 1601) - 800));
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  CHECK(emu.counters().frames == (uint64_t)n + 2);
+  std::printf("bench: %d set_speed in %.3fs = %.0f cmd/s (%.0f ns/cmd)\n", n, s, n / s, s * 1e9 / n);
+}
+
+static void test_pty()
+{
+  MotoronEmulator emu(MotoronEmulator::Bus::Serial);
+  MotoronPtyServer srv(emu);
+  Motoron m(std::make_unique<FdTransport>(srv.slavePath()));
+  m.initBasic();
+  m.setSpeed(2, -400);
+  for (int i = 0; i < 100 && emu.targetSpeed(2) != -400; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  CHECK(emu.targetSpeed(2) == -400);
+  CHECK(emu.protocolOptions() == 0x07);
+
+  FdTransport raw(srv.slavePath());
+  Bytes q = {0x9A, 0x00, 0x00, 0x01};
+  q.push_back(Motoron::crc(q.data(), q.size()));
+  raw.write(q.data(), q.size());
+  uint8_t r[2] = {0xFF, 0xFF};
+  raw.read(r, 2);
+  CHECK(r[0] == 0x07 && r[1] == Motoron::crc(r, 1));
+  srv.stop();
+  std::printf("pty: %s ok\n", srv.slavePath().c_str());
+}
+
+int main(int argc, char **argv)
+{
+  test_crc_matches_reference();
+  test_driver_frames();
+  test_init_and_speeds();
+  test_crc_and_protocol_errors();
+  test_variables_and_responses();
+  test_timeout_and_buffers();
+  test_acceleration();
+  test_serial_framing();
+  test_fault_injection();
+  test_bus_recovery();
+  test_crc_responses();
+  bench_command_rate();
+  if (argc > 1 && std::strcmp(argv[1], "pty") == 0)
+    test_pty();
+
+  if (failures)
+  {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("motoron_emulator_test: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+// Offline check of SpectralMonitor: synthetic tracking error written into
+// a TapRing the way ControlLoop does, band RMS / peaks / alarms read back.
+#include "../SpectralMonitor.h"
+#include "check.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using Sample = TrackingSample<3>;
+using Tap = TapRing<Sample, 4096>;
+using Spectrum = SpectralMonitor<Tap>;
+
+static bool near(double a, double b, double rel) { return std::fabs(a - b) <= rel * std::fabs(b); }
+
+// axis 0: 25 Hz, axis 1: 120 Hz + offset, axis 2: quiet; 1 kHz
+static Sample make(std::size_t n, uint32_t period_ns = 1000000)
+{
+  const double t = (double)n * period_ns * 1e-9;
+  Sample s;
+  s.period_ns = period_ns;
+  s.err[0] = (float)(0.02 * std::sin(2 * M_PI * 25.0 * t));
+  s.err[1] = (float)(0.5 + 0.004 * std::sin(2 * M_PI * 120.0 * t));
+  s.err[2] = 0.0f;
+  s.cmd[0] = (float)(300.0 * std::sin(2 * M_PI * 25.0 * t + 1.0));
+  s.cmd[1] = 0.0f;
+  s.cmd[2] = 0.0f;
+  return s;
+}
+
+static Spectrum::Params params()
+{
+  Spectrum::Params p;
+  p.bands = {{10.0, 40.0, 0.01}, {80.0, 200.0, 0.01}, {300.0, 490.0, 0.0}};
+  return p;
+}
+
+static void test_bands_and_alarms()
+{
+  static Tap tap;
+  Spectrum sm(tap, params());
+  std::size_t n = 0;
+  std::size_t windows = 0;
+  for (int round = 0; round < 8; ++round)
+  {
+    for (int i = 0; i < 500; ++i)
+      tap.put(make(n++));
+    windows += sm.service();
+  }
+  CHECK(windows >= 6);
+
+  Spectrum::Report r;
+  sm.snapshot(r);
+  CHECK(r.windows == windows);
+  CHECK(r.lost == 0);
+  CHECK(r.restarts == 0);
+  CHECK(near(r.fs_hz, 1000.0, 1e-9));
+  CHECK(r.band.size() == 3);
+
+  const double a0 = 0.02 / std::sqrt(2.0), a1 = 0.004 / std::sqrt(2.0);
+  CHECK(near(r.band[0][0].err_rms, a0, 0.03));
+  CHECK(near(r.band[0][0].cmd_rms, 300.0 / std::sqrt(2.0), 0.03));
+  CHECK(std::fabs(r.band[0][0].peak_hz - 25.0) < 1.0);
+  CHECK(r.band[1][0].err_rms < 0.01 * a0); // leakage
+  CHECK(near(r.band[1][1].err_rms, a1, 0.03));
+  CHECK(std::fabs(r.band[1][1].peak_hz - 120.0) < 1.0);
+  CHECK(r.band[0][1].err_rms < 0.01 * a1); // offset removed, no leakage
+  CHECK(r.band[0][2].err_rms == 0.0 && r.band[2][2].err_rms == 0.0);
+
+  // only axis 0 / 10-40 Hz is over its limit
+  CHECK(r.band[0][0].alarm);
+  CHECK(!r.band[1][1].alarm && !r.band[0][1].alarm && !r.band[2][0].alarm);
+  Spectrum::Alarm a;
+  CHECK(sm.popAlarm(a));
+  CHECK(a.raised && a.axis == 0 && a.band == 0);
+  CHECK(!sm.popAlarm(a));
+
+  // quiet again: alarm clears once the window has moved past the tone
+  for (int round = 0; round < 4; ++round)
+  {
+    for (int i = 0; i < 500; ++i)
+    {
+      Sample s = make(n++);
+      s.err[0] = 0.0f;
+      tap.put(s);
+    }
+    sm.service();
+  }
+  sm.snapshot(r);
+  CHECK(!r.band[0][0].alarm);
+  CHECK(sm.popAlarm(a));
+  CHECK(!a.raised && a.axis == 0 && a.band == 0);
+}
+
+// Overrun (reader too slow) and a control-rate change both restart the window
+static void test_lost_and_period_change()
+{
+  static Tap tap;
+  Spectrum sm(tap, params());
+  std::size_t n = 0;
+  for (int i = 0; i < 600; ++i)
+    tap.put(make(n++));
+  CHECK(sm.service() == 0);
+  for (std::size_t i = 0; i < Tap::kCapacity + 100; ++i)
+    tap.put(make(n++));
+  sm.service();
+  Spectrum::Report r;
+  sm.snapshot(r);
+  CHECK(r.lost == 101); // 100 past capacity + the slot claimed by the newest item
+  CHECK(r.restarts == 1);
+
+  // 500 Hz from here on: bins are computed for the new rate
+  const uint32_t slow = 2000000;
+  sm.snapshot(r);
+  const uint64_t before = r.windows;
+  std::size_t m = 0;
+  for (int i = 0; i < 2048; ++i)
+    tap.put(make(m++, slow));
+  sm.service();
+  sm.snapshot(r);
+  CHECK(r.restarts == 2);
+  CHECK(r.windows > before);
+  CHECK(near(r.fs_hz, 500.0, 1e-9));
+  CHECK(std::fabs(r.band[0][0].peak_hz - 25.0) < 1.0);
+  CHECK(near(r.band[0][0].err_rms, 0.02 / std::sqrt(2.0), 0.03));
+  CHECK(r.band[2][0].err_rms == 0.0); // above Nyquist at 500 Hz: no bins
+}
+
+static void test_bad_params()
+{
+  static Tap tap;
+  Spectrum::Params p;
+  p.hop = 0;
+  bool threw = false;
+  try
+  {
+    Spectrum sm(tap, p);
+  }
+  catch (const std::invalid_argument &)
+  {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+// Analysis cost: 3 axes, 1024-sample windows, ~480 bins
+static void bench()
+{
+  static Tap tap;
+  Spectrum::Params p;
+  p.bands = {{1.0, 10.0, 0}, {10.0, 40.0, 0}, {40.0, 150.0, 0}, {150.0, 490.0, 0}};
+  Spectrum sm(tap, p);
+  std::size_t n = 0, windows = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int round = 0; round < 40; ++round)
+  {
+    for (int i = 0; i < 512; ++i)
+      tap.put(make(n++));
+    windows += sm.service();
+  }
+  const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::printf("bench: %zu windows in %.3f s (%.2f ms/window)\n", windows, s, 1e3 * s / (double)windows);
+}
+
+int main()
+{
+  test_bands_and_alarms();
+  test_lost_and_period_change();
+  test_bad_params();
+  bench();
+  if (failures)
+  {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("spectral_test: all checks passed\n");
+  return 0;
+}
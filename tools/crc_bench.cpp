@@ -0,0 +1,164 @@
+// crc_bench.cpp - cost of Motoron CRC per 1 kHz control frame
+//
+//   make crc_bench
+//   ./crc_bench [ticks]
+//
+// One control frame is what Robot::update sends per tick: set_speed_now for
+// each of three axes, plus a status poll (get_variables request and its
+// 2-byte response, checked; the rig polls one board every 50 ms, so this
+// is an upper bound). Measured:
+//   crc        ns/byte of the table CRC against the bitwise definition
+//   encode     ns/frame to encode (and check) the frame without CRC, with
+//              the table CRC and with the bitwise CRC
+//   emulator   ns/frame through Motoron -> EmulatorTransport -> emulator,
+//              which parses and checks every CRC on the board side too
+//   bus        extra I2C time per frame at 100 and 400 kHz (9 bits per
+//              byte, one address byte per transaction)
+#include "../Motoron.h"
+#include "../MotoronEmulator.h"
+#include "../MotoronProtocol.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+namespace mp = motoron_protocol;
+
+static volatile uint32_t sink;
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// the frame's bytes; CRC computed by 'crc' when with_crc
+template <typename Crc>
+static uint32_t encodeFrame(int tick, bool with_crc, Crc crc)
+{
+  uint8_t f[mp::kMaxFrame];
+  uint32_t acc = 0;
+  for (uint8_t motor = 1; motor <= 3; ++motor)
+  {
+    size_t n = mp::setSpeedNow(f, motor, (int16_t)((tick * 7 + motor * 101) % 1601 - 800), false);
+    if (with_crc)
+    {
+      f[n] = crc(f, n);
+      ++n;
+    }
+    acc += f[n - 1];
+  }
+  size_t n = mp::getVariables(f, 0, 1, 2, false);
+  if (with_crc)
+  {
+    f[n] = crc(f, n);
+    ++n;
+  }
+  acc += f[n - 1];
+  // response: flags + CRC as the board would send them
+  uint8_t r[3] = {(uint8_t)tick, (uint8_t)(tick >> 8), 0};
+  if (with_crc)
+  {
+    r[2] = crc(r, 2);
+    acc += crc(r, 2) == r[2];
+  }
+  return acc;
+}
+
+static double benchEncode(int ticks, bool with_crc, bool bitwise)
+{
+  uint32_t acc = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < ticks; ++i)
+    acc += bitwise ? encodeFrame(i, with_crc, mp::crcBitwise) : encodeFrame(i, with_crc, mp::crc);
+  const double s = seconds(t0);
+  sink = acc;
+  return s * 1e9 / ticks;
+}
+
+static double benchEmulator(int ticks, bool with_crc)
+{
+  MotoronEmulator emu;
+  Motoron m(std::make_unique<EmulatorTransport>(emu));
+  m.setCrc(with_crc);
+  m.initBasic();
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < ticks; ++i)
+  {
+    m.collectStatus();
+    for (uint8_t motor = 1; motor <= 3; ++motor)
+      m.trySetSpeed(motor, (int16_t)((i * 7 + motor * 101) % 1601 - 800));
+    m.requestStatus();
+  }
+  const double s = seconds(t0);
+  const Motoron::BusStats bs = m.busStats();
+  if (bs.crc_errors || bs.failed || emu.counters().crc_errors)
+    std::printf("unexpected errors: crc=%llu failed=%llu board_crc=%llu\n", (unsigned long long)bs.crc_errors,
+                (unsigned long long)bs.failed, (unsigned long long)emu.counters().crc_errors);
+  return s * 1e9 / ticks;
+}
+
+int main(int argc, char **argv)
+{
+  const int ticks = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  if (ticks <= 0)
+  {
+    std::fprintf(stderr, "usage: %s [ticks]\n", argv[0]);
+    return 2;
+  }
+
+  // table and definition must agree on every single-byte state transition
+  for (int v = 0; v < 256; ++v)
+  {
+    const uint8_t b = (uint8_t)v;
+    if (mp::crc(&b, 1) != mp::crcBitwise(&b, 1))
+    {
+      std::printf("table mismatch at %d\n", v);
+      return 1;
+    }
+  }
+
+  // raw CRC throughput over a 4 KiB buffer
+  static uint8_t buf[4096];
+  for (size_t i = 0; i < sizeof(buf); ++i)
+    buf[i] = (uint8_t)(i * 131 + 7);
+  const int reps = 2000;
+  uint32_t acc = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < reps; ++i)
+  {
+    buf[0] = (uint8_t)i;
+    acc += mp::crc(buf, sizeof(buf));
+  }
+  const double table_ns = seconds(t0) * 1e9 / ((double)reps * sizeof(buf));
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < reps; ++i)
+  {
+    buf[0] = (uint8_t)i;
+    acc += mp::crcBitwise(buf, sizeof(buf));
+  }
+  const double bit_ns = seconds(t0) * 1e9 / ((double)reps * sizeof(buf));
+  sink = acc;
+  std::printf("crc: table %.2f ns/byte, bitwise %.2f ns/byte (%.1fx)\n", table_ns, bit_ns, bit_ns / table_ns);
+
+  const double plain = benchEncode(ticks, false, false);
+  const double table = benchEncode(ticks, true, false);
+  const double bitwise = benchEncode(ticks, true, true);
+  std::printf("encode: %.1f ns/frame without CRC, %.1f with table CRC (+%.1f ns, %.4f%% of 1 ms), "
+              "%.1f with bitwise CRC\n",
+              plain, table, table - plain, (table - plain) / 1e4, bitwise);
+
+  const int emu_ticks = ticks / 5 > 0 ? ticks / 5 : 1;
+  const double emu_plain = benchEmulator(emu_ticks, false);
+  const double emu_crc = benchEmulator(emu_ticks, true);
+  std::printf("emulator: %.0f ns/frame without CRC, %.0f with CRC (+%.0f ns, %.3f%% of 1 ms)\n", emu_plain,
+              emu_crc, emu_crc - emu_plain, (emu_crc - emu_plain) / 1e4);
+
+  // bytes on the wire per frame: 3 speed writes, poll request, poll read
+  const int plain_bytes = 3 * (1 + 4) + (1 + 4) + (1 + 2);
+  const int crc_bytes = plain_bytes + 3 + 1 + 1;
+  for (double hz : {100e3, 400e3})
+    std::printf("bus @ %.0f kHz: %d -> %d bytes/frame, +%.1f us/frame\n", hz / 1e3, plain_bytes, crc_bytes,
+                (crc_bytes - plain_bytes) * 9 / hz * 1e6);
+  return 0;
+}
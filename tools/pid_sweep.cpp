@@ -0,0 +1,578 @@
+// pid_sweep.cpp - offline PID gain sweep over a simulated DC motor
+//
+//   make pid_sweep
+//   ./pid_sweep --kp 1:100:24 --ki 0:200:16 --kd 0:1:16
+//               --profile step:1 --profile csv:run.csv > pareto.csv
+//
+// Each gain set is a closed-loop simulation of Motor's control path at a
+// fixed period: encoder quantization -> PID -> Motoron speed units (int16,
+// +-800) -> DC motor (R, L, Kt = Ke, J, viscous + Coulomb friction, gear).
+// Gain sets run in SoA batches of kLanes so the per-tick loops vectorize;
+// batches are spread over all cores by a work-stealing pool.
+//
+// The batch PID repeats PID::step's arithmetic lane by lane; at startup a
+// few lanes are re-run through PID::step itself and must match exactly.
+//
+// Scores (all minimized, over every profile):
+//   rms_err    RMS of reference - true output position (rev)
+//   overshoot  largest travel past a reference that has stopped moving (rev)
+//   sat_frac   fraction of ticks with the PID output in saturation
+// stdout gets the Pareto front (non-dominated gain sets), sorted by rms_err.
+#include "../PID.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------- plant
+
+struct Plant
+{
+  double vsupply = 12.0; // Motoron VIN
+  double R = 2.0;        // ohm
+  double L = 1e-3;       // H (0: quasi-static current)
+  double kt = 0.02;      // N*m/A (= Ke in V*s/rad)
+  double J = 2e-5;       // kg*m^2 at the motor shaft
+  double b = 1e-5;       // N*m*s/rad viscous
+  double coulomb = 2e-3; // N*m dry friction
+  double gear = 1.0;     // >1 means reduction
+  double cpr = 4096.0;   // 4x counts per motor rev
+  int substeps = 4;      // integration steps per control period
+};
+
+static constexpr double kTwoPi = 6.283185307179586;
+
+// One control period with voltage v held (ZOH). pos: output rev,
+// w: motor rad/s, i: A. Semi-implicit Euler; the Coulomb term is smoothed
+// around zero speed so it cannot chatter.
+static inline void plantStep(const Plant &p, double v, double dt,
+                             double &pos, double &w, double &i)
+{
+  const double h = dt / p.substeps;
+  for (int s = 0; s < p.substeps; ++s)
+  {
+    if (p.L > 0.0)
+      i += h * (v - p.R * i - p.kt * w) / p.L;
+    else
+      i = (v - p.kt * w) / p.R;
+    const double friction = p.coulomb * w / (std::fabs(w) + 0.05);
+    w += h * (p.kt * i - p.b * w - friction) / p.J;
+    pos += h * w / (kTwoPi * p.gear);
+  }
+}
+
+// What Motor::sample() sees: whole encoder counts
+static inline double measured(const Plant &p, double pos)
+{
+  return std::floor(pos * p.gear * p.cpr) / (p.gear * p.cpr);
+}
+
+// Motor::step: PID output (-1..1) -> Motoron speed (truncated int16) -> volts
+static inline double volts(const Plant &p, double u)
+{
+  const double speed = std::trunc(std::max(-800.0, std::min(800.0, u * 800.0)));
+  return p.vsupply * speed / 800.0;
+}
+
+// ------------------------------------------------------------- profiles
+
+struct Profile
+{
+  std::string name;
+  std::vector<double> ref; // one sample per control period
+};
+
+// step:A[:T]  sine:A:F[:T]  trap:D:V:A[:T]  csv:path (t,ref lines)
+static Profile makeProfile(const std::string &spec, double dt)
+{
+  Profile pr;
+  pr.name = spec;
+  std::vector<std::string> f;
+  std::stringstream ss(spec);
+  for (std::string tok; std::getline(ss, tok, ':');)
+    f.push_back(tok);
+  auto num = [&](size_t k, double def)
+  { return k < f.size() ? std::atof(f[k].c_str()) : def; };
+
+  if (f[0] == "step")
+  {
+    const double a = num(1, 1.0), T = num(2, 2.0);
+    for (double t = 0; t < T; t += dt)
+      pr.ref.push_back(t < 0.1 ? 0.0 : a);
+  }
+  else if (f[0] == "sine")
+  {
+    const double a = num(1, 1.0), hz = num(2, 1.0), T = num(3, 2.0 / hz);
+    for (double t = 0; t < T; t += dt)
+      pr.ref.push_back(a * std::sin(kTwoPi * hz * t));
+  }
+  else if (f[0] == "trap")
+  {
+    // 0 -> D with velocity limit V and acceleration A, then hold
+    const double D = num(1, 10.0), V = num(2, 5.0), A = num(3, 50.0);
+    const double sgn = D < 0 ? -1.0 : 1.0, d = std::fabs(D);
+    const double ta = std::min(V / A, std::sqrt(d / A));
+    const double vmax = A * ta;
+    const double tc = (d - A * ta * ta) / vmax;
+    const double T = num(4, 0.1 + 2 * ta + tc + 1.0);
+    for (double t = 0; t < T; t += dt)
+    {
+      const double s = t - 0.1;
+      double x;
+      if (s <= 0)
+        x = 0;
+      else if (s < ta)
+        x = 0.5 * A * s * s;
+      else if (s < ta + tc)
+        x = 0.5 * A * ta * ta + vmax * (s - ta);
+      else if (s < 2 * ta + tc)
+      {
+        const double r = 2 * ta + tc - s;
+        x = d - 0.5 * A * r * r;
+      }
+      else
+        x = d;
+      pr.ref.push_back(sgn * x);
+    }
+  }
+  else if (f[0] == "csv" && f.size() > 1)
+  {
+    // recorded reference (e.g. from rpimotor.Robot.read_state), resampled
+    std::ifstream in(spec.substr(4));
+    if (!in)
+      throw std::runtime_error("cannot open " + spec.substr(4));
+    std::vector<double> ts, rs;
+    for (std::string line; std::getline(in, line);)
+    {
+      double t, r;
+      if (std::sscanf(line.c_str(), "%lf,%lf", &t, &r) == 2)
+      {
+        ts.push_back(t);
+        rs.push_back(r);
+      }
+    }
+    if (ts.size() < 2)
+      throw std::runtime_error(spec + ": need at least two t,ref rows");
+    size_t k = 0;
+    for (double t = ts.front(); t <= ts.back(); t += dt)
+    {
+      while (k + 2 < ts.size() && ts[k + 1] < t)
+        ++k;
+      const double a = (t - ts[k]) / (ts[k + 1] - ts[k]);
+      pr.ref.push_back(rs[k] + std::max(0.0, std::min(1.0, a)) * (rs[k + 1] - rs[k]));
+    }
+  }
+  else
+    throw std::runtime_error("unknown profile: " + spec);
+  return pr;
+}
+
+// ---------------------------------------------------------- SoA batch
+
+struct Gains
+{
+  double kp, ki, kd;
+};
+
+struct Score
+{
+  double rms, overshoot, sat, max_err;
+};
+
+static constexpr int kLanes = 16;
+
+struct alignas(64) Batch
+{
+  double kp[kLanes], ki[kLanes], kd[kLanes];
+  double integ[kLanes], prev_e[kLanes];
+  double pos[kLanes], w[kLanes], cur[kLanes];
+  double se[kLanes], os[kLanes], sat[kLanes], maxe[kLanes];
+};
+
+struct SimParams
+{
+  Plant plant;
+  double dt = 0.001;
+  double aw = 0.0; // PID anti-windup gain (Motor uses 0)
+};
+
+// All profiles for up to kLanes gain sets. Unused lanes run harmlessly.
+static void runBatch(const SimParams &sp, const std::vector<Profile> &profiles,
+                     const Gains *g, int n, Score *out)
+{
+  Batch b;
+  for (int l = 0; l < kLanes; ++l)
+  {
+    const Gains &s = g[l < n ? l : 0];
+    b.kp[l] = s.kp;
+    b.ki[l] = s.ki;
+    b.kd[l] = s.kd;
+    b.se[l] = b.os[l] = b.sat[l] = b.maxe[l] = 0.0;
+  }
+
+  const Plant &p = sp.plant;
+  const double dt = sp.dt, aw = sp.aw;
+  size_t samples = 0;
+  for (const Profile &pr : profiles)
+  {
+    for (int l = 0; l < kLanes; ++l)
+      b.integ[l] = b.prev_e[l] = b.pos[l] = b.w[l] = b.cur[l] = 0.0;
+
+    double dir = 0.0, last_r = pr.ref.empty() ? 0.0 : pr.ref[0];
+    for (double r : pr.ref)
+    {
+      // overshoot counts only once the reference has stopped moving
+      const double dr = r - last_r;
+      last_r = r;
+      if (dr != 0.0)
+        dir = dr > 0 ? 1.0 : -1.0;
+      const double os_dir = dr == 0.0 ? dir : 0.0;
+
+      for (int l = 0; l < kLanes; ++l)
+      {
+        // --- PID::step (conditional integration or back-calculation) ---
+        const double error = r - measured(p, b.pos[l]);
+        const double p_term = b.kp[l] * error;
+        const double d_term = b.kd[l] * (error - b.prev_e[l]) / dt;
+        const double uu = p_term + b.integ[l] + d_term;
+        const double uc = std::max(-1.0, std::min(uu, 1.0));
+        double integ = b.integ[l];
+        if (aw > 0.0)
+          integ += (b.ki[l] * error + aw * (uc - uu)) * dt;
+        else
+        {
+          const bool hi = (uu >= 1.0) && (error > 0.0);
+          const bool lo = (uu <= -1.0) && (error < 0.0);
+          integ += (hi || lo) ? 0.0 : b.ki[l] * error * dt;
+        }
+        b.integ[l] = std::max(-1e6, std::min(integ, 1e6));
+        b.prev_e[l] = error;
+        b.sat[l] += (uu >= 1.0 || uu <= -1.0) ? 1.0 : 0.0;
+
+        plantStep(p, volts(p, uc), dt, b.pos[l], b.w[l], b.cur[l]);
+
+        const double e = r - b.pos[l];
+        b.se[l] += e * e;
+        b.maxe[l] = std::max(b.maxe[l], std::fabs(e));
+        b.os[l] = std::max(b.os[l], -os_dir * e);
+      }
+    }
+    samples += pr.ref.size();
+  }
+
+  const double inf = std::numeric_limits<double>::infinity();
+  for (int l = 0; l < n; ++l)
+  {
+    Score &s = out[l];
+    s.rms = std::sqrt(b.se[l] / (double)samples);
+    s.overshoot = b.os[l];
+    s.sat = b.sat[l] / (double)samples;
+    s.max_err = b.maxe[l];
+    if (!std::isfinite(s.rms) || !std::isfinite(s.max_err)) // unstable
+      s.rms = s.overshoot = s.sat = s.max_err = inf;
+  }
+}
+
+// Same loop through PID::step; the batch kernel must reproduce it exactly
+static bool checkAgainstPid(const SimParams &sp, const Profile &pr, const Gains *g, int n)
+{
+  const int steps = (int)std::min<size_t>(pr.ref.size(), 2000);
+  Profile cut{pr.name, std::vector<double>(pr.ref.begin(), pr.ref.begin() + steps)};
+  Score batch[kLanes];
+  runBatch(sp, {cut}, g, n, batch);
+  for (int l = 0; l < n; ++l)
+  {
+    PID pid;
+    pid.setGains(g[l].kp, g[l].ki, g[l].kd);
+    pid.setAntiWindupGain(sp.aw);
+    double pos = 0, w = 0, i = 0, se = 0;
+    for (double r : cut.ref)
+    {
+      const double u = pid.step(r, measured(sp.plant, pos), sp.dt);
+      plantStep(sp.plant, volts(sp.plant, u), sp.dt, pos, w, i);
+      se += (r - pos) * (r - pos);
+    }
+    const double rms = std::sqrt(se / steps);
+    if (!(rms == batch[l].rms || (!std::isfinite(rms) && !std::isfinite(batch[l].rms))))
+    {
+      std::fprintf(stderr, "batch kernel diverges from PID::step: kp=%g ki=%g kd=%g rms %.17g vs %.17g\n",
+                   g[l].kp, g[l].ki, g[l].kd, batch[l].rms, rms);
+      return false;
+    }
+  }
+  return true;
+}
+
+// --------------------------------------------------- work-stealing pool
+
+// Tasks are dealt round-robin into per-worker deques; a worker takes from
+// the back of its own and, once empty, steals from the front of others.
+// No task spawns new ones, so all deques empty means the run is done.
+class WorkStealingPool
+{
+public:
+  explicit WorkStealingPool(unsigned n) : q_(n ? n : 1) {}
+
+  template <typename F>
+  void run(size_t n_tasks, F fn)
+  {
+    const unsigned n = (unsigned)q_.size();
+    for (size_t t = 0; t < n_tasks; ++t)
+      q_[t % n].tasks.push_back(t);
+    std::vector<std::thread> th;
+    for (unsigned wid = 0; wid < n; ++wid)
+      th.emplace_back([this, wid, n, &fn]
+                      {
+        size_t t;
+        while (popLocal_(wid, t) || steal_(wid, n, t))
+          fn(t); });
+    for (auto &t : th)
+      t.join();
+  }
+  uint64_t steals() const { return steals_.load(); }
+  unsigned size() const { return (unsigned)q_.size(); }
+
+private:
+  struct alignas(64) Queue
+  {
+    std::mutex m;
+    std::deque<size_t> tasks;
+  };
+
+  bool popLocal_(unsigned wid, size_t &t)
+  {
+    std::lock_guard<std::mutex> lk(q_[wid].m);
+    if (q_[wid].tasks.empty())
+      return false;
+    t = q_[wid].tasks.back();
+    q_[wid].tasks.pop_back();
+    return true;
+  }
+  bool steal_(unsigned wid, unsigned n, size_t &t)
+  {
+    for (unsigned k = 1; k < n; ++k)
+    {
+      Queue &v = q_[(wid + k) % n];
+      std::lock_guard<std::mutex> lk(v.m);
+      if (!v.tasks.empty())
+      {
+        t = v.tasks.front();
+        v.tasks.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<Queue> q_;
+  std::atomic<uint64_t> steals_{0};
+};
+
+// --------------------------------------------------------------- Pareto
+
+static bool dominates(const Score &a, const Score &b)
+{
+  return a.rms <= b.rms && a.overshoot <= b.overshoot && a.sat <= b.sat &&
+         (a.rms < b.rms || a.overshoot < b.overshoot || a.sat < b.sat);
+}
+
+// Sorted by rms, a point can only be dominated by one before it
+static std::vector<size_t> paretoFront(const std::vector<Score> &s)
+{
+  std::vector<size_t> idx;
+  for (size_t i = 0; i < s.size(); ++i)
+    if (std::isfinite(s[i].rms))
+      idx.push_back(i);
+  std::sort(idx.begin(), idx.end(), [&](size_t a, size_t b)
+            { return s[a].rms < s[b].rms || (s[a].rms == s[b].rms && s[a].overshoot < s[b].overshoot); });
+  std::vector<size_t> front;
+  for (size_t i : idx)
+  {
+    bool dominated = false;
+    for (size_t f : front)
+      if (dominates(s[f], s[i]))
+      {
+        dominated = true;
+        break;
+      }
+    if (!dominated)
+      front.push_back(i);
+  }
+  return front;
+}
+
+// ------------------------------------------------------------------ CLI
+
+// min:max:n, log-spaced when min > 0
+static std::vector<double> axisValues(const std::string &spec)
+{
+  double lo, hi;
+  int n;
+  if (std::sscanf(spec.c_str(), "%lf:%lf:%d", &lo, &hi, &n) != 3 || n < 1 || hi < lo)
+    throw std::runtime_error("bad range (want min:max:n): " + spec);
+  std::vector<double> v;
+  for (int k = 0; k < n; ++k)
+  {
+    const double a = n == 1 ? 0.0 : (double)k / (n - 1);
+    v.push_back(lo > 0 ? lo * std::pow(hi / lo, a) : lo + a * (hi - lo));
+  }
+  return v;
+}
+
+static void setPlant(Plant &p, const std::string &kvs)
+{
+  std::stringstream ss(kvs);
+  for (std::string kv; std::getline(ss, kv, ',');)
+  {
+    const auto eq = kv.find('=');
+    if (eq == std::string::npos)
+      throw std::runtime_error("bad plant parameter: " + kv);
+    const std::string k = kv.substr(0, eq);
+    const double v = std::atof(kv.c_str() + eq + 1);
+    if (k == "V") p.vsupply = v;
+    else if (k == "R") p.R = v;
+    else if (k == "L") p.L = v;
+    else if (k == "kt") p.kt = v;
+    else if (k == "J") p.J = v;
+    else if (k == "b") p.b = v;
+    else if (k == "coulomb") p.coulomb = v;
+    else if (k == "gear") p.gear = v;
+    else if (k == "cpr") p.cpr = v;
+    else if (k == "substeps") p.substeps = std::max(1, (int)v);
+    else
+      throw std::runtime_error("unknown plant parameter: " + k);
+  }
+}
+
+static void usage()
+{
+  std::fprintf(stderr,
+               "usage: pid_sweep [--kp min:max:n] [--ki ..] [--kd ..] [--profile spec]...\n"
+               "                 [--plant k=v,...] [--dt s] [--aw gain] [--threads n] [--all file]\n"
+               "  profiles: step:A[:T]  sine:A:F[:T]  trap:D:V:A[:T]  csv:path\n"
+               "  plant:    V R L kt J b coulomb gear cpr substeps\n");
+}
+
+int main(int argc, char **argv)
+{
+  SimParams sp;
+  std::string kp_spec = "1:100:24", ki_spec = "0:200:16", kd_spec = "0:1:16", all_path;
+  std::vector<std::string> profile_specs;
+  unsigned threads = std::thread::hardware_concurrency();
+
+  try
+  {
+    for (int a = 1; a < argc; ++a)
+    {
+      const std::string opt = argv[a];
+      if (opt == "-h" || opt == "--help")
+      {
+        usage();
+        return 0;
+      }
+      if (a + 1 >= argc)
+        throw std::runtime_error("missing value for " + opt);
+      const std::string val = argv[++a];
+      if (opt == "--kp") kp_spec = val;
+      else if (opt == "--ki") ki_spec = val;
+      else if (opt == "--kd") kd_spec = val;
+      else if (opt == "--profile") profile_specs.push_back(val);
+      else if (opt == "--plant") setPlant(sp.plant, val);
+      else if (opt == "--dt") sp.dt = std::atof(val.c_str());
+      else if (opt == "--aw") sp.aw = std::atof(val.c_str());
+      else if (opt == "--threads") threads = (unsigned)std::atoi(val.c_str());
+      else if (opt == "--all") all_path = val;
+      else
+        throw std::runtime_error("unknown option " + opt);
+    }
+    if (!(sp.dt > 0))
+      throw std::runtime_error("--dt must be > 0");
+    if (profile_specs.empty())
+      profile_specs = {"step:1", "trap:10:5:50", "sine:2:1"};
+
+    std::vector<Profile> profiles;
+    size_t ticks = 0;
+    for (const auto &s : profile_specs)
+    {
+      profiles.push_back(makeProfile(s, sp.dt));
+      ticks += profiles.back().ref.size();
+    }
+
+    std::vector<Gains> gains;
+    for (double kp : axisValues(kp_spec))
+      for (double ki : axisValues(ki_spec))
+        for (double kd : axisValues(kd_spec))
+          gains.push_back({kp, ki, kd});
+
+    // the SoA kernel must still be PID::step
+    const int nchk = (int)std::min<size_t>(gains.size(), kLanes);
+    for (const Profile &pr : profiles)
+      if (!checkAgainstPid(sp, pr, gains.data() + gains.size() - nchk, nchk))
+        return 2;
+
+    std::vector<Score> scores(gains.size());
+    const size_t n_batches = (gains.size() + kLanes - 1) / kLanes;
+    WorkStealingPool pool(threads);
+    const auto t0 = std::chrono::steady_clock::now();
+    pool.run(n_batches, [&](size_t bi)
+             {
+      const size_t first = bi * kLanes;
+      const int n = (int)std::min<size_t>(kLanes, gains.size() - first);
+      runBatch(sp, profiles, &gains[first], n, &scores[first]); });
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const std::vector<size_t> front = paretoFront(scores);
+    size_t unstable = 0;
+    for (const Score &s : scores)
+      unstable += !std::isfinite(s.rms);
+
+    auto row = [&](FILE *f, size_t i)
+    {
+      const Score &s = scores[i];
+      std::fprintf(f, "%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n", gains[i].kp, gains[i].ki, gains[i].kd,
+                   s.rms, s.overshoot, s.sat, s.max_err);
+    };
+    const char *header = "kp,ki,kd,rms_err,overshoot,sat_frac,max_err\n";
+    std::fputs(header, stdout);
+    for (size_t i : front)
+      row(stdout, i);
+    if (!all_path.empty())
+    {
+      FILE *f = std::fopen(all_path.c_str(), "w");
+      if (!f)
+        throw std::runtime_error("cannot write " + all_path);
+      std::fputs(header, f);
+      for (size_t i = 0; i < scores.size(); ++i)
+        row(f, i);
+      std::fclose(f);
+    }
+
+    std::fprintf(stderr,
+                 "pid_sweep: %zu gain sets x %zu profiles (%zu ticks) in %.2fs on %u threads "
+                 "(%.1f M sim-ticks/s, %llu steals); %zu unstable, %zu on the Pareto front\n",
+                 gains.size(), profiles.size(), ticks, secs, pool.size(),
+                 (double)gains.size() * ticks / secs / 1e6, (unsigned long long)pool.steals(),
+                 unstable, front.size());
+  }
+  catch (const std::exception &e)
+  {
+    std::fprintf(stderr, "pid_sweep: %s\n", e.what());
+    usage();
+    return 1;
+  }
+  return 0;
+}
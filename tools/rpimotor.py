@@ -0,0 +1,156 @@
+"""
+Thin ctypes wrapper over librpimotor.so (see rpimotor.h).
+
+The C++ library runs the 1 kHz control loop itself; Python only exchanges
+whole per-axis arrays with it, so scripts can drive the robot without
+touching the I2C bus:
+
+  from rpimotor import Robot
+  with Robot() as r:
+    r.enable(True)
+    r.start()
+    r.set_references([1.0, 0.0, -1.0])
+    state = r.read_state()   # dict of per-axis lists
+"""
+
+import ctypes
+import os
+
+ABI_VERSION = 1
+
+
+class RpiMotorError(RuntimeError):
+  pass
+
+
+class Stats(ctypes.Structure):
+  _fields_ = [
+    ("iters", ctypes.c_uint64),
+    ("misses", ctypes.c_uint64),
+    ("worst_overrun_ns", ctypes.c_int64),
+    ("rate_level", ctypes.c_uint32),
+    ("period_ns", ctypes.c_int64),
+  ]
+
+
+def _load(path=None):
+  if path is None:
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.path.join(here, "..", "librpimotor.so"), "librpimotor.so"]
+  else:
+    candidates = [path]
+  err = None
+  for c in candidates:
+    try:
+      lib = ctypes.CDLL(c)
+      break
+    except OSError as e:
+      err = e
+  else:
+    raise RpiMotorError("cannot load librpimotor.so: %s" % err)
+
+  dp = ctypes.POINTER(ctypes.c_double)
+  h = ctypes.c_void_p
+  lib.rpimotor_abi_version.restype = ctypes.c_uint32
+  lib.rpimotor_last_error.restype = ctypes.c_char_p
+  lib.rpimotor_create.restype = h
+  lib.rpimotor_destroy.argtypes = [h]
+  lib.rpimotor_axis_count.argtypes = [h]
+  lib.rpimotor_axis_count.restype = ctypes.c_size_t
+  for name in ("rpimotor_start", "rpimotor_stop"):
+    getattr(lib, name).argtypes = [h]
+  lib.rpimotor_enable.argtypes = [h, ctypes.c_int]
+  lib.rpimotor_set_references.argtypes = [h, dp, ctypes.c_size_t]
+  lib.rpimotor_read_state.argtypes = [
+    h, dp, ctypes.POINTER(ctypes.c_uint64), dp, dp, dp, ctypes.c_size_t]
+  lib.rpimotor_read_stats.argtypes = [h, ctypes.POINTER(Stats)]
+
+  if lib.rpimotor_abi_version() != ABI_VERSION:
+    raise RpiMotorError("librpimotor ABI %d, wrapper expects %d"
+      % (lib.rpimotor_abi_version(), ABI_VERSION))
+  return lib
+
+
+class Robot:
+  """
+  One robot as compiled into librpimotor.so (RobotConfig.h).
+  Arrays are in RigConfig::axes order.
+  """
+
+  def __init__(self, lib_path=None):
+    self._h = None
+    self._lib = _load(lib_path)
+    self._h = self._lib.rpimotor_create()
+    if not self._h:
+      raise RpiMotorError(self._error())
+    self.axes = self._lib.rpimotor_axis_count(self._h)
+    arr = ctypes.c_double * self.axes
+    # reused buffers: one call per batch, no per-axis round trips
+    self._ref = arr()
+    self._pos = arr()
+    self._refs_out = arr()
+    self._cmd = arr()
+    self._t = ctypes.c_double()
+    self._tick = ctypes.c_uint64()
+
+  def _error(self):
+    return self._lib.rpimotor_last_error().decode(errors="replace")
+
+  def _check(self, rc):
+    if rc != 0:
+      raise RpiMotorError(self._error())
+
+  def start(self):
+    """Starts the RT control loop inside the library."""
+    self._check(self._lib.rpimotor_start(self._h))
+
+  def stop(self):
+    """Stops the control loop; outputs coast."""
+    self._check(self._lib.rpimotor_stop(self._h))
+
+  def enable(self, en=True):
+    self._check(self._lib.rpimotor_enable(self._h, 1 if en else 0))
+
+  def set_references(self, revs):
+    """Sets every axis reference (revolutions); applied on one control tick."""
+    if len(revs) != self.axes:
+      raise ValueError("expected %d references, got %d" % (self.axes, len(revs)))
+    for i, v in enumerate(revs):
+      self._ref[i] = v
+    self._check(self._lib.rpimotor_set_references(self._h, self._ref, self.axes))
+
+  def read_state(self):
+    """
+    Returns the state of the latest control tick as a dict:
+    t (s, CLOCK_MONOTONIC), tick, position, reference, command (lists).
+    """
+    self._check(self._lib.rpimotor_read_state(
+      self._h, ctypes.byref(self._t), ctypes.byref(self._tick),
+      self._pos, self._refs_out, self._cmd, self.axes))
+    return {
+      "t": self._t.value,
+      "tick": self._tick.value,
+      "position": list(self._pos),
+      "reference": list(self._refs_out),
+      "command": list(self._cmd),
+    }
+
+  def read_stats(self):
+    """Takes the control-thread stats window (iters, misses, rate level)."""
+    s = Stats()
+    self._check(self._lib.rpimotor_read_stats(self._h, ctypes.byref(s)))
+    return {f: getattr(s, f) for f, _ in Stats._fields_}
+
+  def close(self):
+    if getattr(self, "_h", None):
+      self._lib.rpimotor_destroy(self._h)
+      self._h = None
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, *exc):
+    self.close()
+
+  def __del__(self):
+    self.close()
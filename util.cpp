@@ -1,6 +1,8 @@
 #include "util.h"
 #include <thread>
 #include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
 #include <cstring>
 #include <cerrno>
 #include <stdexcept>
@@ -15,35 +17,69 @@ void set_realtime(int prio)
   }
 }
 
+void pin_to_cpu(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (rc != 0)
+  {
+    throw std::runtime_error(std::string("pthread_setaffinity_np: ") + std::strerror(rc));
+  }
+}
+
 ThreadMonitor::ThreadMonitor(const char *name) : name_(name) {}
 
 void ThreadMonitor::begin_iter()
 {
+  t_prev_start_ = t_start_;
   t_start_ = clock_t::now();
 }
 
-void ThreadMonitor::end_iter(std::chrono::nanoseconds period)
+bool ThreadMonitor::end_iter(std::chrono::nanoseconds period)
+{
+  if (end_iter_nowait(period))
+    return true;
+  // spin-wait to be precise and avoid sleep jitter
+  const auto next_deadline = t_start_ + period;
+  while (clock_t::now() < next_deadline)
+    std::this_thread::yield();
+  return false;
+}
+
+bool ThreadMonitor::end_iter_nowait(std::chrono::nanoseconds budget)
 {
   auto t_end = clock_t::now();
   auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - t_start_);
   busy_ns_ += elapsed;
+  last_busy_ = elapsed;
+#ifdef RT_SENTINEL
+  if (rt_rec_.load(std::memory_order_relaxed) && ++rusage_iters_ >= rusage_every_)
+    sample_rusage_();
+#endif
   ++iters_;
 
-  // Deadline / sleep-until
-  auto next_deadline = t_start_ + period;
+  // Deadline
+  auto next_deadline = t_start_ + budget;
   if (t_end > next_deadline)
   {
     ++misses_;
     auto over = std::chrono::duration_cast<std::chrono::nanoseconds>(t_end - next_deadline).count();
     if (over > worst_overrun_ns_)
       worst_overrun_ns_ = over;
+    return true;
   }
-  else
-  {
-    // spin-wait to be precise and avoid sleep jitter
-    while (clock_t::now() < next_deadline)
-      std::this_thread::yield();
-  }
+  return false;
+}
+
+std::chrono::nanoseconds ThreadMonitor::last_busy() const { return last_busy_; }
+
+std::chrono::nanoseconds ThreadMonitor::last_dt() const
+{
+  if (t_prev_start_ == clock_t::time_point{})
+    return std::chrono::nanoseconds(0);
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t_start_ - t_prev_start_);
 }
 
 void ThreadMonitor::snapshot_reset(double &util_percent, uint64_t &iters, uint64_t &misses, int64_t &worst_overrun_ns)
@@ -63,4 +99,66 @@ void ThreadMonitor::snapshot_reset(double &util_percent, uint64_t &iters, uint64
   util_percent = -1.0; // caller will fill
 }
 
+void ThreadMonitor::tag_rt()
+{
+  if (!rt_sentinel::kEnabled)
+    return;
+  rt_sentinel::ThreadRecord *rec = rt_sentinel::tagCurrentThread(name_, true);
+  struct rusage ru{};
+  getrusage(RUSAGE_THREAD, &ru);
+  last_minflt_ = ru.ru_minflt;
+  last_majflt_ = ru.ru_majflt;
+  last_vcsw_ = ru.ru_nvcsw;
+  last_ivcsw_ = ru.ru_nivcsw;
+  last_allocs_ = rec ? rec->allocs.load(std::memory_order_relaxed) : 0;
+  rt_rec_.store(rec, std::memory_order_release);
+}
+
+void ThreadMonitor::untag_rt()
+{
+  if (!rt_rec_.exchange(nullptr, std::memory_order_acq_rel))
+    return;
+  rt_sentinel::untagCurrentThread();
+}
+
+void ThreadMonitor::sample_rusage_()
+{
+  rusage_iters_ = 0;
+  struct rusage ru{};
+  if (getrusage(RUSAGE_THREAD, &ru) != 0)
+    return;
+  rt_minflt_.fetch_add(ru.ru_minflt - last_minflt_, std::memory_order_relaxed);
+  rt_majflt_.fetch_add(ru.ru_majflt - last_majflt_, std::memory_order_relaxed);
+  rt_vcsw_.fetch_add(ru.ru_nvcsw - last_vcsw_, std::memory_order_relaxed);
+  rt_ivcsw_.fetch_add(ru.ru_nivcsw - last_ivcsw_, std::memory_order_relaxed);
+  last_minflt_ = ru.ru_minflt;
+  last_majflt_ = ru.ru_majflt;
+  last_vcsw_ = ru.ru_nvcsw;
+  last_ivcsw_ = ru.ru_nivcsw;
+
+  const uint64_t a = rt_rec_.load(std::memory_order_relaxed)->allocs.load(std::memory_order_relaxed);
+  rt_allocs_.fetch_add(a - last_allocs_, std::memory_order_relaxed);
+  last_allocs_ = a;
+}
+
+void ThreadMonitor::rt_snapshot_reset(RtStats &out)
+{
+  out.allocs = rt_allocs_.exchange(0, std::memory_order_relaxed);
+  out.minflt = rt_minflt_.exchange(0, std::memory_order_relaxed);
+  out.majflt = rt_majflt_.exchange(0, std::memory_order_relaxed);
+  out.vcsw = rt_vcsw_.exchange(0, std::memory_order_relaxed);
+  out.ivcsw = rt_ivcsw_.exchange(0, std::memory_order_relaxed);
+  out.n_recent = 0;
+  rt_sentinel::ThreadRecord *rec = rt_rec_.load(std::memory_order_acquire);
+  if (!rec)
+    return;
+  // keep the first few call sites, drop the rest of the window
+  rt_sentinel::Violation v;
+  while (rec->pop(v))
+  {
+    if (out.n_recent < sizeof(out.recent) / sizeof(out.recent[0]))
+      out.recent[out.n_recent++] = v;
+  }
+}
+
 const char *ThreadMonitor::name() const { return name_; }
\ No newline at end of file
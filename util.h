@@ -1,7 +1,11 @@
 #pragma once
+#include "RtSentinel.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 void set_realtime(int prio = 80);
+void pin_to_cpu(int cpu); // pin the calling thread to one core
 
 // Simple per-thread timing monitor: measure busy time, utilization, deadline misses
 class ThreadMonitor
@@ -9,19 +13,47 @@ class ThreadMonitor
 public:
     explicit ThreadMonitor(const char *name = "thread");
     void begin_iter();                              // call at loop start
-    void end_iter(std::chrono::nanoseconds period); // call at loop end; records stats & handles deadline
+    bool end_iter(std::chrono::nanoseconds period); // call at loop end; records stats & handles deadline, true on miss
+    bool end_iter_nowait(std::chrono::nanoseconds budget); // same stats, no waiting: true if busy > budget
+    std::chrono::nanoseconds last_busy() const;     // busy time of the last finished iteration
+    std::chrono::nanoseconds last_dt() const;       // start-to-start time of the current iteration (0 on the first)
     // Call from housekeeping every ~1s to get a snapshot and reset window
     void snapshot_reset(double &util_percent, uint64_t &iters, uint64_t &misses, int64_t &worst_overrun_ns);
 
+    // RT hot-path sentinel window (all zero unless built with RT_SENTINEL)
+    struct RtStats
+    {
+        uint64_t allocs{0};               // allocations on the tagged thread
+        uint64_t minflt{0}, majflt{0};    // page faults
+        uint64_t vcsw{0}, ivcsw{0};       // voluntary / involuntary context switches
+        rt_sentinel::Violation recent[4]; // first allocation call sites in the window
+        uint32_t n_recent{0};
+    };
+    void tag_rt();                     // call once from the monitored thread itself
+    void untag_rt();                   // from the same thread before it exits
+    void rt_snapshot_reset(RtStats &out); // housekeeping, alongside snapshot_reset
+
     const char *name() const;
 
 private:
     const char *name_;
     using clock_t = std::chrono::steady_clock;
     clock_t::time_point t_start_{};
+    clock_t::time_point t_prev_start_{};
+    std::chrono::nanoseconds last_busy_{0};
     // accumulators for the current window
     uint64_t iters_{0};
     uint64_t misses_{0};
     int64_t worst_overrun_ns_{0};
     std::chrono::nanoseconds busy_ns_{0};
+
+    // sentinel: getrusage(RUSAGE_THREAD) must run on the monitored thread,
+    // so end_iter samples it every rusage_every_ iterations
+    void sample_rusage_();
+    std::atomic<rt_sentinel::ThreadRecord *> rt_rec_{nullptr};
+    uint32_t rusage_iters_{0};
+    static constexpr uint32_t rusage_every_ = 500;
+    long last_minflt_{0}, last_majflt_{0}, last_vcsw_{0}, last_ivcsw_{0};
+    uint64_t last_allocs_{0};
+    std::atomic<uint64_t> rt_allocs_{0}, rt_minflt_{0}, rt_majflt_{0}, rt_vcsw_{0}, rt_ivcsw_{0};
 };
\ No newline at end of file